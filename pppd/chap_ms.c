@@ -106,15 +106,14 @@
 #undef PPP_WITH_MPPE
 #endif
 
+#define HEXVAL(c)	(isdigit((u_char)(c)) ? (c) - '0' : tolower((u_char)(c)) - 'a' + 10)
+
 static void	ascii2unicode (char[], int, u_char[]);
 static void	NTPasswordHash (u_char *, int, unsigned char *);
+static int	NTSecretHash (char *, int, u_char[MD4_DIGEST_LENGTH]);
 static int	ChallengeResponse (u_char *, u_char *, u_char*);
-static void	ChapMS_NT (u_char *, char *, int, u_char[24]);
-static void	ChapMS2_NT (u_char *, u_char[16], char *, char *, int,
-				u_char[24]);
-static void	GenerateAuthenticatorResponsePlain
-			(char*, int, u_char[24], u_char[16], u_char *,
-			 char *, u_char[41]);
+static void	AuthenticatorResponse (u_char *, u_char *, u_char[8],
+				u_char *);
 #ifdef PPP_WITH_MSLANMAN
 static void	ChapMS_LANMan (u_char *, char *, int, u_char *);
 #endif
@@ -123,6 +122,7 @@ static void	ChapMS_LANMan (u_char *, char *, int, u_char *);
 bool	ms_lanman = 0;    	/* Use LanMan password instead of NT */
 			  	/* Has meaning only with MS-CHAP challenges */
 #endif
+static bool ms_nt_hash = 0;	/* Secrets may be $NT$ password hashes */
 
 #ifdef PPP_WITH_MPPE
 #ifdef DEBUGMPPEKEY
@@ -145,6 +145,8 @@ static struct option chapms_option_list[] = {
 	{ "ms-lanman", o_bool, &ms_lanman,
 	  "Use LanMan passwd when using MS-CHAP", 1 },
 #endif
+	{ "mschap-nt-hash", o_bool, &ms_nt_hash,
+	  "Take $NT$ secrets as NT password hashes", OPT_PRIV | 1 },
 #ifdef DEBUGMPPEKEY
 	{ "mschap-challenge", o_string, &mschap_challenge,
 	  "specify CHAP challenge" },
@@ -319,25 +321,35 @@ chapms_make_response(unsigned char *response, int id, char *our_name,
 	ChapMS(challenge, secret, secret_len, response);
 }
 
+/*
+ * Cache of the responses we generated as the authenticatee, so that a
+ * retransmitted challenge is answered without redoing the crypto and
+ * the authenticator response in the Success packet can be checked.
+ * Entries are direct-mapped by CHAP id, which is the only key
+ * chapms2_check_success() has; the challenge is compared on lookup.
+ */
 struct chapms2_response_cache_entry {
-	int id;
+	int id;			/* -1 if the slot is unused */
 	unsigned char challenge[16];
 	unsigned char response[MS_CHAP2_RESPONSE_LEN];
 	unsigned char auth_response[MS_AUTH_RESPONSE_LENGTH];
 };
 
-#define CHAPMS2_MAX_RESPONSE_CACHE_SIZE 10
+#define CHAPMS2_RESPONSE_CACHE_SIZE	16	/* must be a power of 2 */
+#define CHAPMS2_RESPONSE_CACHE_SLOT(id)	((id) & (CHAPMS2_RESPONSE_CACHE_SIZE - 1))
 static struct chapms2_response_cache_entry
-    chapms2_response_cache[CHAPMS2_MAX_RESPONSE_CACHE_SIZE];
-static int chapms2_response_cache_next_index = 0;
-static int chapms2_response_cache_size = 0;
+    chapms2_response_cache[CHAPMS2_RESPONSE_CACHE_SIZE] = {
+	[0 ... CHAPMS2_RESPONSE_CACHE_SIZE - 1] = { .id = -1 }
+};
+static unsigned int chapms2_response_cache_hits;
+static unsigned int chapms2_response_cache_misses;
 
 static void
 chapms2_add_to_response_cache(int id, unsigned char *challenge,
 			      unsigned char *response,
 			      unsigned char *auth_response)
 {
-	int i = chapms2_response_cache_next_index;
+	int i = CHAPMS2_RESPONSE_CACHE_SLOT(id);
 
 	chapms2_response_cache[i].id = id;
 	memcpy(chapms2_response_cache[i].challenge, challenge, 16);
@@ -345,10 +357,6 @@ chapms2_add_to_response_cache(int id, unsigned char *challenge,
 	       MS_CHAP2_RESPONSE_LEN);
 	memcpy(chapms2_response_cache[i].auth_response,
 	       auth_response, MS_AUTH_RESPONSE_LENGTH);
-	chapms2_response_cache_next_index =
-		(i + 1) % CHAPMS2_MAX_RESPONSE_CACHE_SIZE;
-	if (chapms2_response_cache_next_index > chapms2_response_cache_size)
-		chapms2_response_cache_size = chapms2_response_cache_next_index;
 	dbglog("added response cache entry %d", i);
 }
 
@@ -356,22 +364,24 @@ static struct chapms2_response_cache_entry*
 chapms2_find_in_response_cache(int id, unsigned char *challenge,
 		      unsigned char *auth_response)
 {
-	int i;
-
-	for (i = 0; i < chapms2_response_cache_size; i++) {
-		if (id == chapms2_response_cache[i].id
-		    && (!challenge
-			|| memcmp(challenge,
-				  chapms2_response_cache[i].challenge,
-				  16) == 0)
-		    && (!auth_response
-			|| memcmp(auth_response,
-				  chapms2_response_cache[i].auth_response,
-				  MS_AUTH_RESPONSE_LENGTH) == 0)) {
-			dbglog("response found in cache (entry %d)", i);
-			return &chapms2_response_cache[i];
-		}
+	int i = CHAPMS2_RESPONSE_CACHE_SLOT(id);
+
+	if (id == chapms2_response_cache[i].id
+	    && (!challenge
+		|| memcmp(challenge,
+			  chapms2_response_cache[i].challenge,
+			  16) == 0)
+	    && (!auth_response
+		|| memcmp(auth_response,
+			  chapms2_response_cache[i].auth_response,
+			  MS_AUTH_RESPONSE_LENGTH) == 0)) {
+		++chapms2_response_cache_hits;
+		dbglog("response found in cache (entry %d, %u hits, %u misses)",
+		       i, chapms2_response_cache_hits,
+		       chapms2_response_cache_misses);
+		return &chapms2_response_cache[i];
 	}
+	++chapms2_response_cache_misses;
 	return NULL;  /* not found */
 }
 
@@ -592,51 +602,44 @@ ascii2unicode(char ascii[], int ascii_len, u_char unicode[])
 static void
 NTPasswordHash(u_char *secret, int secret_len, unsigned char* hash)
 {
-    PPP_MD_CTX* ctx = PPP_MD_CTX_new();
-    if (ctx != NULL) {
-
-        if (PPP_DigestInit(ctx, PPP_md4())) {
+    unsigned int hash_len = MD4_DIGEST_LENGTH;
 
-            if (PPP_DigestUpdate(ctx, secret, secret_len)) {
-
-                int hash_len = MD4_DIGEST_LENGTH;
-                PPP_DigestFinal(ctx, hash, &hash_len);
-            }
-        }
-        
-        PPP_MD_CTX_free(ctx);
-    }
+    PPP_Digest(PPP_md4(), secret, secret_len, hash, &hash_len);
 }
 
-static void
-ChapMS_NT(u_char *rchallenge, char *secret, int secret_len,
-	  u_char NTResponse[24])
+/*
+ * Get the NT password hash for a secret.  With the mschap-nt-hash
+ * option, a secret of the form "$NT$" followed by 32 hex digits is
+ * taken to be the hash itself, so chap-secrets need not hold the
+ * plaintext password and no MD4 is needed per authentication.
+ * Returns 1 in that case, 0 if the hash was computed from a plaintext
+ * secret.
+ */
+static int
+NTSecretHash(char *secret, int secret_len,
+	     u_char PasswordHash[MD4_DIGEST_LENGTH])
 {
     u_char	unicodePassword[MAX_NT_PASSWORD * 2];
-    u_char	PasswordHash[MD4_DIGEST_LENGTH];
-
-    /* Hash the Unicode version of the secret (== password). */
-    ascii2unicode(secret, secret_len, unicodePassword);
-    NTPasswordHash(unicodePassword, secret_len * 2, PasswordHash);
-
-    ChallengeResponse(rchallenge, PasswordHash, NTResponse);
-}
+    int		i;
 
-static void
-ChapMS2_NT(u_char *rchallenge, u_char PeerChallenge[16], char *username,
-	   char *secret, int secret_len, u_char NTResponse[24])
-{
-    u_char	unicodePassword[MAX_NT_PASSWORD * 2];
-    u_char	PasswordHash[MD4_DIGEST_LENGTH];
-    u_char	Challenge[8];
+    if (ms_nt_hash && secret_len == NT_HASH_PREFIX_LEN + 2 * MD4_DIGEST_LENGTH
+	&& memcmp(secret, NT_HASH_PREFIX, NT_HASH_PREFIX_LEN) == 0) {
+	for (i = 0; i < MD4_DIGEST_LENGTH; ++i) {
+	    char *p = &secret[NT_HASH_PREFIX_LEN + i * 2];
 
-    ChallengeHash(PeerChallenge, rchallenge, username, Challenge);
+	    if (!isxdigit((u_char)p[0]) || !isxdigit((u_char)p[1]))
+		break;
+	    PasswordHash[i] = (HEXVAL(p[0]) << 4) | HEXVAL(p[1]);
+	}
+	if (i == MD4_DIGEST_LENGTH)
+	    return 1;
+    }
 
     /* Hash the Unicode version of the secret (== password). */
     ascii2unicode(secret, secret_len, unicodePassword);
     NTPasswordHash(unicodePassword, secret_len * 2, PasswordHash);
-
-    ChallengeResponse(Challenge, PasswordHash, NTResponse);
+    BZERO(unicodePassword, sizeof(unicodePassword));
+    return 0;
 }
 
 #ifdef PPP_WITH_MSLANMAN
@@ -669,6 +672,21 @@ GenerateAuthenticatorResponse(unsigned char* PasswordHashHash,
 			      unsigned char *NTResponse, unsigned char *PeerChallenge,
 			      unsigned char *rchallenge, char *username,
 			      unsigned char *authResponse)
+{
+    u_char	Challenge[8];
+
+    ChallengeHash(PeerChallenge, rchallenge, username, Challenge);
+    AuthenticatorResponse(PasswordHashHash, NTResponse, Challenge,
+			  authResponse);
+}
+
+/*
+ * The second half of GenerateAuthenticatorResponse(), for callers that
+ * already have the ChallengeHash() of the peer and authenticator challenges.
+ */
+static void
+AuthenticatorResponse(u_char *PasswordHashHash, u_char *NTResponse,
+		      u_char Challenge[8], u_char *authResponse)
 {
     /*
      * "Magic" constants used in response generation, from RFC 2759.
@@ -689,7 +707,6 @@ GenerateAuthenticatorResponse(unsigned char* PasswordHashHash,
     PPP_MD_CTX *ctx;
     u_char	Digest[SHA_DIGEST_LENGTH] = {};
     int     hash_len;
-    u_char	Challenge[8];
 
     ctx = PPP_MD_CTX_new();
     if (ctx != NULL) {
@@ -708,19 +725,12 @@ GenerateAuthenticatorResponse(unsigned char* PasswordHashHash,
                 }
             }
         }
-        PPP_MD_CTX_free(ctx);
-    }
-    
-    ChallengeHash(PeerChallenge, rchallenge, username, Challenge);
-
-    ctx = PPP_MD_CTX_new();
-    if (ctx != NULL) {
 
         if (PPP_DigestInit(ctx, PPP_sha1())) {
 
             if (PPP_DigestUpdate(ctx, Digest, sizeof(Digest))) {
 
-                if (PPP_DigestUpdate(ctx, Challenge, sizeof(Challenge))) {
+                if (PPP_DigestUpdate(ctx, Challenge, 8)) {
 
                     if (PPP_DigestUpdate(ctx, Magic2, sizeof(Magic2))) {
                         
@@ -741,64 +751,21 @@ GenerateAuthenticatorResponse(unsigned char* PasswordHashHash,
 }
 
 
-static void
-GenerateAuthenticatorResponsePlain
-		(char *secret, int secret_len,
-		 u_char NTResponse[24], u_char PeerChallenge[16],
-		 u_char *rchallenge, char *username,
-		 u_char authResponse[MS_AUTH_RESPONSE_LENGTH+1])
-{
-    u_char	unicodePassword[MAX_NT_PASSWORD * 2];
-    u_char	PasswordHash[MD4_DIGEST_LENGTH];
-    u_char	PasswordHashHash[MD4_DIGEST_LENGTH];
-
-    /* Hash (x2) the Unicode version of the secret (== password). */
-    ascii2unicode(secret, secret_len, unicodePassword);
-    NTPasswordHash(unicodePassword, secret_len * 2, PasswordHash);
-    NTPasswordHash(PasswordHash, sizeof(PasswordHash),
-		   PasswordHashHash);
-
-    GenerateAuthenticatorResponse(PasswordHashHash, NTResponse, PeerChallenge,
-				  rchallenge, username, authResponse);
-}
-
-
 #ifdef PPP_WITH_MPPE
 
 /*
  * Set mppe_xxxx_key from MS-CHAP credentials. (see RFC 3079)
  */
 static void
-Set_Start_Key(u_char *rchallenge, char *secret, int secret_len)
+Set_Start_Key(u_char *rchallenge, u_char PasswordHash[MD4_DIGEST_LENGTH])
 {
-    u_char	unicodePassword[MAX_NT_PASSWORD * 2];
-    u_char	PasswordHash[MD4_DIGEST_LENGTH];
     u_char	PasswordHashHash[MD4_DIGEST_LENGTH];
 
-    /* Hash (x2) the Unicode version of the secret (== password). */
-    ascii2unicode(secret, secret_len, unicodePassword);
-    NTPasswordHash(unicodePassword, secret_len * 2, PasswordHash);
-    NTPasswordHash(PasswordHash, sizeof(PasswordHash), PasswordHashHash);
+    NTPasswordHash(PasswordHash, MD4_DIGEST_LENGTH, PasswordHashHash);
 
     mppe_set_chapv1(rchallenge, PasswordHashHash);
 }
 
-/*
- * Set mppe_xxxx_key from MS-CHAPv2 credentials. (see RFC 3079)
- */
-static void
-SetMasterKeys(char *secret, int secret_len, u_char NTResponse[24], int IsServer)
-{
-    u_char	unicodePassword[MAX_NT_PASSWORD * 2];
-    u_char	PasswordHash[MD4_DIGEST_LENGTH];
-    u_char	PasswordHashHash[MD4_DIGEST_LENGTH];
-    /* Hash (x2) the Unicode version of the secret (== password). */
-    ascii2unicode(secret, secret_len, unicodePassword);
-    NTPasswordHash(unicodePassword, secret_len * 2, PasswordHash);
-    NTPasswordHash(PasswordHash, sizeof(PasswordHash), PasswordHashHash);
-    mppe_set_chapv2(PasswordHashHash, NTResponse, IsServer);
-}
-
 #endif /* PPP_WITH_MPPE */
 
 
@@ -806,23 +773,30 @@ void
 ChapMS(u_char *rchallenge, char *secret, int secret_len,
        unsigned char *response)
 {
-    BZERO(response, MS_CHAP_RESPONSE_LEN);
+    u_char	PasswordHash[MD4_DIGEST_LENGTH];
 
-    ChapMS_NT(rchallenge, secret, secret_len, &response[MS_CHAP_NTRESP]);
+    BZERO(response, MS_CHAP_RESPONSE_LEN);
 
 #ifdef PPP_WITH_MSLANMAN
-    ChapMS_LANMan(rchallenge, secret, secret_len,
-		  &response[MS_CHAP_LANMANRESP]);
-
-    /* preferred method is set by option  */
-    response[MS_CHAP_USENT] = !ms_lanman;
+    /* The LANMan response needs the plaintext password */
+    if (!NTSecretHash(secret, secret_len, PasswordHash)) {
+	ChapMS_LANMan(rchallenge, secret, secret_len,
+		      &response[MS_CHAP_LANMANRESP]);
+
+	/* preferred method is set by option  */
+	response[MS_CHAP_USENT] = !ms_lanman;
+    } else
+	response[MS_CHAP_USENT] = 1;
 #else
+    NTSecretHash(secret, secret_len, PasswordHash);
     response[MS_CHAP_USENT] = 1;
 #endif
+    ChallengeResponse(rchallenge, PasswordHash, &response[MS_CHAP_NTRESP]);
 
 #ifdef PPP_WITH_MPPE
-    Set_Start_Key(rchallenge, secret, secret_len);
+    Set_Start_Key(rchallenge, PasswordHash);
 #endif
+    BZERO(PasswordHash, sizeof(PasswordHash));
 }
 
 
@@ -843,6 +817,9 @@ ChapMS2(unsigned char *rchallenge, unsigned char *PeerChallenge,
 {
     /* ARGSUSED */
     u_char *p = &response[MS_CHAP2_PEER_CHALLENGE];
+    u_char	PasswordHash[MD4_DIGEST_LENGTH];
+    u_char	PasswordHashHash[MD4_DIGEST_LENGTH];
+    u_char	Challenge[8];
     int i;
 
     BZERO(response, MS_CHAP2_RESPONSE_LEN);
@@ -855,20 +832,29 @@ ChapMS2(unsigned char *rchallenge, unsigned char *PeerChallenge,
 	BCOPY(PeerChallenge, &response[MS_CHAP2_PEER_CHALLENGE],
 	      MS_CHAP2_PEER_CHAL_LEN);
 
+    /*
+     * The challenge hash and the password hashes are each needed by
+     * more than one of the steps below; compute them only once.
+     */
+    ChallengeHash(&response[MS_CHAP2_PEER_CHALLENGE], rchallenge, user,
+		  Challenge);
+
+    NTSecretHash(secret, secret_len, PasswordHash);
+    NTPasswordHash(PasswordHash, sizeof(PasswordHash), PasswordHashHash);
+
     /* Generate the NT-Response */
-    ChapMS2_NT(rchallenge, &response[MS_CHAP2_PEER_CHALLENGE], user,
-	       secret, secret_len, &response[MS_CHAP2_NTRESP]);
+    ChallengeResponse(Challenge, PasswordHash, &response[MS_CHAP2_NTRESP]);
 
     /* Generate the Authenticator Response. */
-    GenerateAuthenticatorResponsePlain(secret, secret_len,
-				       &response[MS_CHAP2_NTRESP],
-				       &response[MS_CHAP2_PEER_CHALLENGE],
-				       rchallenge, user, authResponse);
+    AuthenticatorResponse(PasswordHashHash, &response[MS_CHAP2_NTRESP],
+			  Challenge, authResponse);
 
 #ifdef PPP_WITH_MPPE
-    SetMasterKeys(secret, secret_len,
-		  &response[MS_CHAP2_NTRESP], authenticator);
+    mppe_set_chapv2(PasswordHashHash, &response[MS_CHAP2_NTRESP],
+		    authenticator);
 #endif
+
+    BZERO(PasswordHash, sizeof(PasswordHash));
 }
 
 
@@ -972,6 +958,48 @@ int test_chap_v2(void) {
         strncmp(saresponse, saresult, MS_AUTH_RESPONSE_LENGTH);
 }
 
+int test_chap_v2_nthash(void) {
+    /* NtPasswordHash("clientPass") from RFC 2759, section 9.2 */
+    char *secret = "$NT$44ebba8d5312b8d611474411f56989ae";
+    char *name = "User";
+
+    char saresponse[MS_AUTH_RESPONSE_LENGTH+1];
+    char *saresult = "407A5589115FD0D6209F510FE9C04566932CDA56";
+
+    unsigned char authenticator[16] = {
+        0x5B, 0x5D, 0x7C, 0x7D, 0x7B, 0x3F, 0x2F, 0x3E,
+        0x3C, 0x2C, 0x60, 0x21, 0x32, 0x26, 0x26, 0x28
+    };
+    unsigned char peerchallenge[16] = {
+        0x21, 0x40, 0x23, 0x24, 0x25, 0x5E, 0x26, 0x2A,
+        0x28, 0x29, 0x5F, 0x2B, 0x3A, 0x33, 0x7C, 0x7E
+    };
+    unsigned char result[MS_CHAP_NTRESP_LEN] = {
+        0x82, 0x30, 0x9E, 0xCD, 0x8D, 0x70, 0x8B, 0x5E,
+        0xA0, 0x8F, 0xAA, 0x39, 0x81, 0xCD, 0x83, 0x54,
+        0x42, 0x33, 0x11, 0x4A, 0x3D, 0x85, 0xD6, 0xDF
+    };
+
+    unsigned char response[MS_CHAP2_RESPONSE_LEN] = {
+    };
+
+    /* without mschap-nt-hash the secret is a plaintext password */
+	ChapMS2(authenticator, peerchallenge, name,
+		secret, strlen(secret), response,
+		(unsigned char *)saresponse, MS_CHAP2_AUTHENTICATOR);
+    if (!memcmp(&response[MS_CHAP2_NTRESP], result, MS_CHAP2_NTRESP_LEN))
+        return 1;
+
+    ms_nt_hash = 1;
+	ChapMS2(authenticator, peerchallenge, name,
+		secret, strlen(secret), response,
+		(unsigned char *)saresponse, MS_CHAP2_AUTHENTICATOR);
+    ms_nt_hash = 0;
+
+    return memcmp(&response[MS_CHAP2_NTRESP], result, MS_CHAP2_NTRESP_LEN) ||
+        strncmp(saresponse, saresult, MS_AUTH_RESPONSE_LENGTH);
+}
+
 int main(int argc, char *argv[]) {
     
     PPP_crypto_init();
@@ -986,6 +1014,11 @@ int main(int argc, char *argv[]) {
         return -1;
     }
 
+    if (test_chap_v2_nthash()) {
+        printf("CHAPv2 with NT hash secret failed\n");
+        return -1;
+    }
+
     PPP_crypto_deinit();
 
     printf("Success\n");
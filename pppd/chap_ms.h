@@ -40,6 +40,8 @@ extern "C" {
 #endif
 
 #define MAX_NT_PASSWORD		256	/* Max (Unicode) chars in an NT pass */
+#define NT_HASH_PREFIX		"$NT$"	/* Secret is a hex NT password hash */
+#define NT_HASH_PREFIX_LEN	4
 
 #define MS_CHAP_RESPONSE_LEN	49	/* Response length for MS-CHAP */
 #define MS_CHAP2_RESPONSE_LEN	49	/* Response length for MS-CHAPv2 */
@@ -65,5 +65,25 @@ struct _PPP_CIPHER_CTX
     void *priv;
 };
 
+#ifdef PPP_WITH_OPENSSL
+#include <openssl/evp.h>
+
+/*
+ * Algorithm implementations fetched once by PPP_crypto_init(). These are
+ * NULL with OpenSSL < 3.0, or before PPP_crypto_init() has been called,
+ * in which case the backends use the EVP_md4() etc. getters instead.
+ */
+struct crypto_algs {
+    EVP_MD *md4;
+    EVP_MD *md5;
+    EVP_MD *sha1;
+    EVP_CIPHER *des_ecb;
+};
+
+extern struct crypto_algs g_crypto_algs;
+
+#define PPP_EVP_ALG(name, getter) \
+    (g_crypto_algs.name ? g_crypto_algs.name : getter())
+#endif
 
 #endif
@@ -52,6 +52,8 @@ struct crypto_ctx {
     OSSL_PROVIDER *provider;
 } g_crypto_ctx;
 #endif
+
+struct crypto_algs g_crypto_algs;
 #endif
 
 PPP_MD_CTX *PPP_MD_CTX_new()
@@ -73,6 +75,13 @@ int PPP_DigestInit(PPP_MD_CTX *ctx, const PPP_MD *type)
 {
     int ret = 0;
     if (ctx) {
+        /*
+         * Re-initialising for the same digest lets the backend reuse its
+         * state in ctx->priv rather than free and allocate it again.
+         */
+        if (ctx->md.clean_fn && ctx->md.init_fn != type->init_fn) {
+            ctx->md.clean_fn(ctx);
+        }
         ctx->md = *type;
         if (ctx->md.init_fn) {
             ret = ctx->md.init_fn(ctx);
@@ -108,6 +117,23 @@ int PPP_DigestFinal(PPP_MD_CTX *ctx, unsigned char *out, unsigned int *outlen)
     return ret;
 }
 
+int PPP_Digest(const PPP_MD *type, const void *data, size_t length,
+        unsigned char *out, unsigned int *outlen)
+{
+    PPP_MD_CTX ctx = {};
+    int ret = 0;
+
+    if (PPP_DigestInit(&ctx, type)
+        && PPP_DigestUpdate(&ctx, data, length)
+        && PPP_DigestFinal(&ctx, out, outlen)) {
+        ret = 1;
+    }
+    if (ctx.md.clean_fn) {
+        ctx.md.clean_fn(&ctx);
+    }
+    return ret;
+}
+
 PPP_CIPHER_CTX *PPP_CIPHER_CTX_new(void)
 {
     return calloc(1, sizeof(PPP_CIPHER_CTX));
@@ -130,6 +156,9 @@ int PPP_CipherInit(PPP_CIPHER_CTX *ctx, const PPP_CIPHER *cipher, const unsigned
     int ret = 0;
     if (ctx && cipher) {
         ret = 1;
+        if (ctx->cipher.clean_fn) {
+            ctx->cipher.clean_fn(ctx);
+        }
         ctx->is_encr = encr;
         ctx->cipher = *cipher;
         if (ctx->cipher.init_fn) {
@@ -166,6 +195,28 @@ int PPP_CipherFinal(PPP_CIPHER_CTX *ctx, unsigned char *out, int *outl)
     return ret;
 }
 
+int PPP_Cipher(const PPP_CIPHER *cipher, const unsigned char *key,
+        const unsigned char *iv, int encr, unsigned char *out, int *outl,
+        const unsigned char *in, int inl)
+{
+    PPP_CIPHER_CTX ctx = {};
+    int ret = 0;
+    int len = 0, flen = 0;
+
+    if (PPP_CipherInit(&ctx, cipher, key, iv, encr)
+        && PPP_CipherUpdate(&ctx, out, &len, in, inl)
+        && PPP_CipherFinal(&ctx, out + len, &flen)) {
+        *outl = len + flen;
+        ret = 1;
+    }
+    if (ctx.cipher.clean_fn) {
+        ctx.cipher.clean_fn(&ctx);
+    }
+    memset(ctx.iv, 0, sizeof(ctx.iv));
+    memset(ctx.key, 0, sizeof(ctx.key));
+    return ret;
+}
+
 void
 PPP_crypto_error(char *fmt, ...)
 {
@@ -215,6 +266,17 @@ int PPP_crypto_init()
         PPP_crypto_error("Could not load default provider");
         goto done;
     }
+
+    /*
+     * Resolve the algorithms once here, rather than having every
+     * EVP_DigestInit() call look them up in the provider store.
+     * Failure is not fatal: the backends fall back to EVP_md4() etc.
+     */
+    g_crypto_algs.md4 = EVP_MD_fetch(NULL, "MD4", NULL);
+    g_crypto_algs.md5 = EVP_MD_fetch(NULL, "MD5", NULL);
+    g_crypto_algs.sha1 = EVP_MD_fetch(NULL, "SHA1", NULL);
+    g_crypto_algs.des_ecb = EVP_CIPHER_fetch(NULL, "DES-ECB", NULL);
+    ERR_clear_error();
 #endif
 #endif
 
@@ -229,6 +291,12 @@ int PPP_crypto_deinit()
 {
 #ifdef PPP_WITH_OPENSSL
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MD_free(g_crypto_algs.md4);
+    EVP_MD_free(g_crypto_algs.md5);
+    EVP_MD_free(g_crypto_algs.sha1);
+    EVP_CIPHER_free(g_crypto_algs.des_ecb);
+    memset(&g_crypto_algs, 0, sizeof(g_crypto_algs));
+
     if (g_crypto_ctx.legacy) {
         OSSL_PROVIDER_unload(g_crypto_ctx.legacy);
         g_crypto_ctx.legacy = NULL;
@@ -526,6 +594,77 @@ int test_des_decrypt()
     return success;
 }
 
+int test_oneshot()
+{
+    PPP_MD_CTX* ctx = NULL;
+    int success = 0;
+
+    unsigned char data[8] = {
+        0x4f, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x63
+    };
+
+    unsigned char key[8] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07
+    };
+
+    unsigned char cipher[8] = {
+        0x45, 0xdb, 0x80, 0x45, 0x16, 0xd0, 0x6d, 0x60
+    };
+
+    unsigned int  hash_len;
+    unsigned char hash[SHA_DIGEST_LENGTH];
+    unsigned char hash2[SHA_DIGEST_LENGTH];
+    unsigned char out[8];
+    int outlen = 0;
+
+    /* One-shot digest must match the init/update/final sequence, also
+       when the same context is initialised more than once */
+    hash_len = sizeof(hash);
+    if (!PPP_Digest(PPP_sha1(), data, sizeof(data), hash, &hash_len)) {
+        return 0;
+    }
+
+    ctx = PPP_MD_CTX_new();
+    if (ctx) {
+
+        if (PPP_DigestInit(ctx, PPP_md5()) &&
+            PPP_DigestInit(ctx, PPP_sha1()) &&
+            PPP_DigestUpdate(ctx, data, sizeof(data))) {
+
+            hash_len = sizeof(hash2);
+            if (PPP_DigestFinal(ctx, hash2, &hash_len)) {
+
+                if (memcmp(hash, hash2, SHA_DIGEST_LENGTH) == 0) {
+                    success = 1;
+                }
+            }
+        }
+
+        /* Again, reusing the backend state of the finished digest */
+        memset(hash2, 0, sizeof(hash2));
+        hash_len = sizeof(hash2);
+        if (!PPP_DigestInit(ctx, PPP_sha1()) ||
+            !PPP_DigestUpdate(ctx, data, sizeof(data)) ||
+            !PPP_DigestFinal(ctx, hash2, &hash_len) ||
+            memcmp(hash, hash2, SHA_DIGEST_LENGTH) != 0) {
+            success = 0;
+        }
+        PPP_MD_CTX_free(ctx);
+    }
+
+    if (success) {
+        success = 0;
+        if (PPP_Cipher(PPP_des_ecb(), key, NULL, 1, out, &outlen, data, sizeof(data)) &&
+            outlen == 8 && memcmp(out, cipher, 8) == 0 &&
+            PPP_Cipher(PPP_des_ecb(), key, NULL, 0, out, &outlen, cipher, sizeof(cipher)) &&
+            outlen == 8 && memcmp(out, data, 8) == 0) {
+            success = 1;
+        }
+    }
+
+    return success;
+}
+
 int main(int argc, char *argv[])
 {
     int failure = 0;
@@ -560,6 +699,11 @@ int main(int argc, char *argv[])
         failure++;
     }
 
+    if (!test_oneshot()) {
+        printf("One-shot digest/cipher test failed\n");
+        failure++;
+    }
+
     if (!PPP_crypto_deinit()) {
         printf("Couldn't deinitialize crypto test\n");
         return -1;
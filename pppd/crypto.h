@@ -95,6 +95,14 @@ int PPP_DigestUpdate(PPP_MD_CTX *ctx,
 int PPP_DigestFinal(PPP_MD_CTX *ctx,
         unsigned char *out, unsigned int *outlen);
 
+/*
+ * Compute the digest of a single buffer in one call, without allocating
+ * a digest context.
+ */
+int PPP_Digest(const PPP_MD *type,
+        const void *data, size_t cnt,
+        unsigned char *out, unsigned int *outlen);
+
 
 struct _PPP_CIPHER_CTX;
 struct _PPP_CIPHER;
@@ -146,6 +154,17 @@ int PPP_CipherUpdate(PPP_CIPHER_CTX *ctx,
 int PPP_CipherFinal(PPP_CIPHER_CTX *ctx,
         unsigned char *out, int *outl);
 
+/*
+ * Encrypt (encr=1) or decrypt a single buffer in one call, without
+ * allocating a cipher context. *outl is set to the total output length.
+ */
+int PPP_Cipher(const PPP_CIPHER *cipher,
+        const unsigned char *key,
+        const unsigned char *iv,
+        int encr,
+        unsigned char *out, int *outl,
+        const unsigned char *in, int inl);
+
 /*
  * Log an error message to the log and append the crypto error
  */
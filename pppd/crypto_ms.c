@@ -37,6 +37,7 @@
 #endif
 
 #include <stddef.h>
+#include <string.h>
 
 #include "crypto.h"
 #include "crypto_ms.h"
@@ -126,27 +127,15 @@ int
 DesEncrypt(const unsigned char *clear, const unsigned char *key, unsigned char *cipher)
 {
     int retval = 0;
-    unsigned int clen = 0;
+    int clen = 0;
     unsigned char des_key[8];
 
-    PPP_CIPHER_CTX *ctx = PPP_CIPHER_CTX_new();
-    if (ctx) {
-
-        MakeKey(key, des_key);
-        
-        if (PPP_CipherInit(ctx, PPP_des_ecb(), des_key, NULL, 1)) {
-
-            if (PPP_CipherUpdate(ctx, cipher, &clen, clear, 8)) {
-
-                if (PPP_CipherFinal(ctx, cipher + clen, &clen)) {
-
-                    retval = 1;
-                }
-            }
-        }
-        
-        PPP_CIPHER_CTX_free(ctx);
+    MakeKey(key, des_key);
+    if (PPP_Cipher(PPP_des_ecb(), des_key, NULL, 1, cipher, &clen, clear, 8)
+        && clen == 8) {
+        retval = 1;
     }
+    memset(des_key, 0, sizeof(des_key));
 
 	return (retval);
 }
@@ -155,27 +144,15 @@ int
 DesDecrypt(const unsigned char *cipher, const unsigned char *key, unsigned char *clear)
 {
     int retval = 0;
-    unsigned int clen = 0;
+    int clen = 0;
     unsigned char des_key[8];
 
-    PPP_CIPHER_CTX *ctx = PPP_CIPHER_CTX_new();
-    if (ctx) {
-
-        MakeKey(key, des_key);
-        
-        if (PPP_CipherInit(ctx, PPP_des_ecb(), des_key, NULL, 0)) {
-
-            if (PPP_CipherUpdate(ctx, clear, &clen, cipher, 8)) {
-
-                if (PPP_CipherFinal(ctx, clear + clen, &clen)) {
-
-                    retval = 1;
-                }
-            }
-        }
-        
-        PPP_CIPHER_CTX_free(ctx);
+    MakeKey(key, des_key);
+    if (PPP_Cipher(PPP_des_ecb(), des_key, NULL, 0, clear, &clen, cipher, 8)
+        && clen == 8) {
+        retval = 1;
     }
+    memset(des_key, 0, sizeof(des_key));
 
 	return (retval);
 }
@@ -73,6 +73,10 @@ struct packet {
 struct packet *pend_q;
 struct packet *pend_qtail;
 
+#ifdef PPP_WITH_FILTER
+static int kernel_pass_filter;	/* kernel applies pass_filter to looped frames */
+#endif
+
 static int active_packet(unsigned char *, int);
 
 /*
@@ -103,7 +107,7 @@ demand_conf(void)
 	    fatal("Couldn't set up demand-dialled PPP interface: %m");
 
 #ifdef PPP_WITH_FILTER
-    set_filters(&pass_filter, &active_filter);
+    kernel_pass_filter = set_filters(&pass_filter, &active_filter);
 #endif
 
     /*
@@ -339,7 +343,11 @@ active_packet(unsigned char *p, int len)
     proto = PPP_PROTOCOL(p);
 #ifdef PPP_WITH_FILTER
     p[0] = 1;		/* outbound packet indicator */
-    if ((pass_filter.bf_len != 0
+    /*
+     * The kernel runs pass_filter before looping a frame back to us,
+     * so only interpret it here if it couldn't be given to the kernel.
+     */
+    if ((!kernel_pass_filter && pass_filter.bf_len != 0
 	 && bpf_filter(pass_filter.bf_insns, p, len, len) == 0)
 	|| (active_filter.bf_len != 0
 	    && bpf_filter(active_filter.bf_insns, p, len, len) == 0)) {
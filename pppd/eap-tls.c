@@ -81,6 +81,27 @@ static ENGINE *pkey_engine = NULL;
 /* TLSv1.3 do we have a session ticket ? */
 static int have_session_ticket = 0;
 
+/*
+ * The SSL_CTX built for each role (client, server) is kept and shared
+ * by later sessions in this process, so the CA, CRL, certificate and
+ * private key are only loaded again when one of those files changes.
+ */
+#define EAPTLS_CTX_FILES    7
+
+struct eaptls_ctx_cache {
+    SSL_CTX *ctx;
+    char     file[EAPTLS_CTX_FILES][MAXWORDLEN];
+    time_t   mtime[EAPTLS_CTX_FILES];
+    ino_t    ino[EAPTLS_CTX_FILES];
+};
+
+static struct eaptls_ctx_cache eaptls_ctx_cache[2];
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define SSL_CTX_up_ref(ctx) \
+    CRYPTO_add(&(ctx)->references, 1, CRYPTO_LOCK_SSL_CTX)
+#endif
+
 void ssl_msg_callback(int write_p, int version, int ct, const void *buf,
               size_t len, SSL * ssl, void *arg);
 int ssl_new_session_cb(SSL *s, SSL_SESSION *sess);
@@ -620,6 +641,61 @@ fail:
     return NULL;
 }
 
+/*
+ * Return a reference to an SSL_CTX for the given role and credentials,
+ * reusing the one built for an earlier session if none of the files it
+ * was loaded from have changed since.  Release it with SSL_CTX_free().
+ */
+static SSL_CTX *eaptls_get_ssl_ctx(int init_server, char *cacertfile,
+            char *capath, char *certfile, char *privkeyfile, char *pkcs12)
+{
+    struct eaptls_ctx_cache *cc = &eaptls_ctx_cache[init_server != 0];
+    const char *file[EAPTLS_CTX_FILES] = {
+        cacertfile, capath, certfile, privkeyfile, pkcs12, crl_dir, crl_file
+    };
+    time_t      mtime[EAPTLS_CTX_FILES];
+    ino_t       ino[EAPTLS_CTX_FILES];
+    struct stat st;
+    SSL_CTX    *ctx;
+    int         i, same = (cc->ctx != NULL);
+
+    for (i = 0; i < EAPTLS_CTX_FILES; i++) {
+        if (!file[i])
+            file[i] = "";
+        mtime[i] = 0;
+        ino[i] = 0;
+        if (file[i][0] && stat(file[i], &st) == 0) {
+            mtime[i] = st.st_mtime;
+            ino[i] = st.st_ino;
+        }
+        if (strcmp(cc->file[i], file[i]) != 0
+            || cc->mtime[i] != mtime[i] || cc->ino[i] != ino[i])
+            same = 0;
+    }
+
+    if (!same) {
+        ctx = eaptls_init_ssl(init_server, cacertfile, capath, certfile,
+                              privkeyfile, pkcs12);
+        if (!ctx)
+            return NULL;
+
+        if (cc->ctx) {
+            dbglog("EAP-TLS: credentials changed, SSL context reloaded");
+            SSL_CTX_free(cc->ctx);
+        }
+        cc->ctx = ctx;
+        for (i = 0; i < EAPTLS_CTX_FILES; i++) {
+            strlcpy(cc->file[i], file[i], sizeof(cc->file[i]));
+            cc->mtime[i] = mtime[i];
+            cc->ino[i] = ino[i];
+        }
+    } else
+        dbglog("EAP-TLS: reusing SSL context");
+
+    SSL_CTX_up_ref(cc->ctx);
+    return cc->ctx;
+}
+
 /*
  * Determine the maximum packet size by looking at the LCP handshake
  */
@@ -679,7 +755,7 @@ int eaptls_init_ssl_server(eap_state * esp)
 
     ets->mtu = eaptls_get_mtu(esp->es_unit);
 
-    ets->ctx = eaptls_init_ssl(1, cacertfile, capath, servcertfile, pkfile, pkcs12);
+    ets->ctx = eaptls_get_ssl_ctx(1, cacertfile, capath, servcertfile, pkfile, pkcs12);
     if (!ets->ctx)
         goto fail;
 
@@ -709,7 +785,7 @@ int eaptls_init_ssl_server(eap_state * esp)
 
     ets->tls_v13 = 0;
 
-    ets->data = NULL;
+    ets->pending = 0;
     ets->datalen = 0;
     ets->alert_sent = 0;
     ets->alert_recv = 0;
@@ -717,6 +793,7 @@ int eaptls_init_ssl_server(eap_state * esp)
 
 fail:
     SSL_CTX_free(ets->ctx);
+    ets->ctx = NULL;
     return 0;
 }
 
@@ -751,8 +828,8 @@ int eaptls_init_ssl_client(eap_state * esp)
         return 0;
     }
 
-    dbglog( "calling eaptls_init_ssl" );
-    ets->ctx = eaptls_init_ssl(0, cacertfile, capath, clicertfile, pkfile, pkcs12);
+    dbglog( "calling eaptls_get_ssl_ctx" );
+    ets->ctx = eaptls_get_ssl_ctx(0, cacertfile, capath, clicertfile, pkfile, pkcs12);
     if (!ets->ctx)
         goto fail;
 
@@ -778,7 +855,7 @@ int eaptls_init_ssl_client(eap_state * esp)
 
     ets->tls_v13 = 0;
 
-    ets->data = NULL;
+    ets->pending = 0;
     ets->datalen = 0;
     ets->alert_sent = 0;
     ets->alert_recv = 0;
@@ -787,6 +864,7 @@ int eaptls_init_ssl_client(eap_state * esp)
 fail:
     dbglog( "eaptls_init_ssl_client: fail" );
     SSL_CTX_free(ets->ctx);
+    ets->ctx = NULL;
     return 0;
 
 }
@@ -819,15 +897,27 @@ int eaptls_is_init_finished(struct eaptls_session *ets)
     return 0;
 }
 
+/*
+ * Throw away a partly received message, so that the fragments already
+ * in the memory BIO are never handed to the ssl engine.
+ */
+static void eaptls_drop_message(struct eaptls_session *ets)
+{
+    BIO_reset(ets->into_ssl);
+    ets->pending = 0;
+    ets->datalen = 0;
+}
+
 /*
  * Handle a received packet, reassembling fragmented messages and
- * passing them to the ssl engine
+ * passing them to the ssl engine.  The fragments are appended to the
+ * memory BIO as they arrive, so it doubles as the reassembly buffer.
  */
 int eaptls_receive(struct eaptls_session *ets, u_char * inp, int len)
 {
     u_char flags;
     u_int tlslen = 0;
-    u_char dummy[65536];
+    u_char dummy[256];          /* EAP-TLS carries no application data */
 
     if (len < 1) {
         warn("EAP-TLS: received no or invalid data");
@@ -848,35 +938,25 @@ int eaptls_receive(struct eaptls_session *ets, u_char * inp, int len)
         GETLONG(tlslen, inp);
         len -= 4;
 
-        if (!ets->data) {
+        if (!ets->pending) {
 
             if (tlslen > EAP_TLS_MAX_LEN) {
                 error("EAP-TLS: TLS message length > %d, truncated", EAP_TLS_MAX_LEN);
                 tlslen = EAP_TLS_MAX_LEN;
             }
 
-            /*
-             * Allocate memory for the whole message
-            */
-            ets->data = malloc(tlslen);
-            if (!ets->data)
-                fatal("EAP-TLS: allocation error\n");
-
+            ets->pending = 1;
             ets->datalen = 0;
             ets->tlslen = tlslen;
         }
         else
             warn("EAP-TLS: non-first LI packet? that's odd...");
     }
-    else if (!ets->data) {
+    else if (!ets->pending) {
         /*
          * A non fragmented message without LI flag
         */
- 
-        ets->data = malloc(len);
-        if (!ets->data)
-            fatal("EAP-TLS: memory allocation error in eaptls_receive\n");
- 
+        ets->pending = 1;
         ets->datalen = 0;
         ets->tlslen = len;
     }
@@ -893,30 +973,30 @@ int eaptls_receive(struct eaptls_session *ets, u_char * inp, int len)
 
     if (len + ets->datalen > ets->tlslen) {
         warn("EAP-TLS: received data > TLS message length");
+        eaptls_drop_message(ets);
         return 1;
     }
 
-    BCOPY(inp, ets->data + ets->datalen, len);
+    if (len > 0 && BIO_write(ets->into_ssl, inp, len) != len)
+        tls_log_sslerr();
     ets->datalen += len;
 
     if (!ets->frag) {
 
         /*
-         * If we have the whole message, pass it to ssl 
+         * If we have the whole message, let ssl process it
          */
+        ets->pending = 0;
 
         if (ets->datalen != ets->tlslen) {
             warn("EAP-TLS: received data != TLS message length");
+            eaptls_drop_message(ets);
             return 1;
         }
 
-        if (BIO_write(ets->into_ssl, ets->data, ets->datalen) == -1)
-            tls_log_sslerr();
-
-        SSL_read(ets->ssl, dummy, 65536);
+        while (SSL_read(ets->ssl, dummy, sizeof(dummy)) > 0)
+            ;
 
-        free(ets->data);
-        ets->data = NULL;
         ets->datalen = 0;
     }
 
@@ -925,44 +1005,38 @@ int eaptls_receive(struct eaptls_session *ets, u_char * inp, int len)
 
 /*
  * Return an eap-tls packet in outp.
- * A TLS message read from the ssl engine is buffered in ets->data.
- * At each call we control if there is buffered data and send a 
- * packet of mtu bytes.
+ * A TLS message produced by the ssl engine is left in the from_ssl
+ * memory BIO, and each call reads the next packet of up to mtu bytes
+ * from it directly into outp.
  */
 int eaptls_send(struct eaptls_session *ets, u_char ** outp)
 {
     bool first = 0;
     int size;
-    u_char fromtls[65536];
+    u_char dummy[256];
     int res;
     u_char *start;
 
     start = *outp;
 
-    if (!ets->data)
+    if (!ets->pending)
     {
         if(!ets->alert_sent)
         {
-            res = SSL_read(ets->ssl, fromtls, 65536);
+            SSL_read(ets->ssl, dummy, sizeof(dummy));
         }
 
         /*
-         * Read from ssl 
+         * Find out how much ssl has for us
          */
-        if ((res = BIO_read(ets->from_ssl, fromtls, 65536)) == -1)
+        if ((res = BIO_ctrl_pending(ets->from_ssl)) <= 0)
         {
             warn("EAP-TLS send: No data from BIO_read");
             return 1;
         }
 
+        ets->pending = 1;
         ets->datalen = res;
-
-        ets->data = malloc(ets->datalen);
-        if (!ets->data)
-            fatal("EAP-TLS: memory allocation error in eaptls_send\n");
-
-        BCOPY(fromtls, ets->data, ets->datalen);
-
         ets->offset = 0;
         first = 1;
     }
@@ -989,9 +1063,16 @@ int eaptls_send(struct eaptls_session *ets, u_char ** outp)
         PUTCHAR(0, *outp);
 
     /*
-     * Copy the data in outp 
+     * Read the data into outp 
      */
-    BCOPY(ets->data + ets->offset, *outp, size);
+    if (BIO_read(ets->from_ssl, *outp, size) != size)
+    {
+        warn("EAP-TLS send: short BIO_read");
+        BIO_reset(ets->from_ssl);
+        ets->pending = 0;
+        *outp = start;          /* don't send the headers on their own */
+        return 1;
+    }
     INCPTR(size, *outp);
 
     /*
@@ -1007,9 +1088,7 @@ int eaptls_send(struct eaptls_session *ets, u_char ** outp)
         /*
          * The whole message has been sent 
          */
-
-        free(ets->data);
-        ets->data = NULL;
+        ets->pending = 0;
         ets->datalen = 0;
         ets->offset = 0;
     }
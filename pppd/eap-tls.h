@@ -49,8 +49,8 @@ struct tls_info;
 
 struct eaptls_session
 {
-    u_char *data;               /* buffered data */
-    int datalen;                /* buffered data len */
+    bool pending;               /* TLS message being received or sent */
+    int datalen;                /* bytes of it received, or its length */
     int offset;                 /* from where to send */
     int tlslen;                 /* total length of tls data */
     bool frag;                  /* packet is fragmented */
@@ -325,6 +325,107 @@ eap_send_success(eap_state *esp)
 }
 
 #ifdef PPP_WITH_SRP
+/*
+ * SHA-1 context shared by the SRP code while the link is up.
+ * Lightweight rechallenges recur for the life of the link; reusing one
+ * context also lets the crypto backend keep its digest state.
+ */
+static PPP_MD_CTX *srp_ctxt;
+
+static PPP_MD_CTX *
+srp_sha1_ctx(void)
+{
+	if (srp_ctxt == NULL)
+		srp_ctxt = PPP_MD_CTX_new();
+	return (srp_ctxt);
+}
+
+#ifndef DEFAULT_CONF
+#define DEFAULT_CONF	"/etc/tpasswd.conf"
+#endif
+
+/*
+ * Verifier, salt and group parsed from the last srp-secrets entry
+ * used.  Rechallenges of the same peer reuse these rather than
+ * decoding the entry and reading tpasswd.conf again.
+ */
+static struct srp_verifier_cache {
+	bool valid;
+	char secret[MAXWORDLEN];	/* entry these were parsed from */
+	struct t_pw tpw;
+	struct t_confent tce;
+	time_t conf_mtime;		/* tpasswd.conf the group came from */
+	ino_t conf_ino;
+	u_char modbuf[MAXPARAMLEN];	/* gettcid() storage is static */
+	u_char genbuf[MAXPARAMLEN];
+	unsigned int hits, misses;
+} srp_vcache;
+
+/*
+ * Parse an srp-secrets entry of the form "index:verifier:salt".  The
+ * entry is modified.  Returns NULL if it is malformed.  The cached
+ * result is used if the entry is unchanged and, for a group from
+ * tpasswd.conf, that file hasn't changed either.
+ */
+static struct srp_verifier_cache *
+srp_get_verifier(char *secret)
+{
+	struct srp_verifier_cache *vc = &srp_vcache;
+	struct t_confent *tce;
+	struct stat sbuf;
+	char *cp, *cp2;
+	int id;
+
+	if (stat(DEFAULT_CONF, &sbuf) < 0)
+		BZERO(&sbuf, sizeof (sbuf));
+	if (vc->valid && strcmp(vc->secret, secret) == 0 &&
+	    (vc->tce.index == 0 || (vc->conf_mtime == sbuf.st_mtime &&
+	    vc->conf_ino == sbuf.st_ino))) {
+		++vc->hits;
+		dbglog("EAP-SRP: reusing verifier (%u hits, %u misses)",
+		    vc->hits, vc->misses);
+		return (vc);
+	}
+	++vc->misses;
+	vc->valid = 0;
+	strlcpy(vc->secret, secret, sizeof (vc->secret));
+
+	/* Get t_confent based on index in srp-secrets */
+	id = strtol(secret, &cp, 10);
+	if (*cp++ != ':' || id < 0)
+		return (NULL);
+	if (id == 0) {
+		vc->tce.index = 0;
+		vc->tce.modulus.data = (u_char *)wkmodulus;
+		vc->tce.modulus.len = sizeof (wkmodulus);
+		vc->tce.generator.data = (u_char *)"\002";
+		vc->tce.generator.len = 1;
+	} else if ((tce = gettcid(id)) != NULL &&
+	    tce->modulus.len <= sizeof (vc->modbuf) &&
+	    tce->generator.len <= sizeof (vc->genbuf)) {
+		vc->tce.index = tce->index;
+		BCOPY(tce->modulus.data, vc->modbuf, tce->modulus.len);
+		vc->tce.modulus.data = vc->modbuf;
+		vc->tce.modulus.len = tce->modulus.len;
+		BCOPY(tce->generator.data, vc->genbuf, tce->generator.len);
+		vc->tce.generator.data = vc->genbuf;
+		vc->tce.generator.len = tce->generator.len;
+	} else {
+		return (NULL);
+	}
+	if ((cp2 = strchr(cp, ':')) == NULL)
+		return (NULL);
+	*cp2++ = '\0';
+	vc->conf_mtime = sbuf.st_mtime;
+	vc->conf_ino = sbuf.st_ino;
+	vc->tpw.pebuf.password.len = t_fromb64((char *)vc->tpw.pwbuf, cp);
+	vc->tpw.pebuf.password.data = (char*) vc->tpw.pwbuf;
+	vc->tpw.pebuf.salt.len = t_fromb64((char *)vc->tpw.saltbuf, cp2);
+	vc->tpw.pebuf.salt.data = vc->tpw.saltbuf;
+	vc->valid = 1;
+	return (vc);
+}
+
 /*
  * Set DES key according to pseudonym-generating secret and current
  * date.
@@ -342,7 +443,7 @@ pncrypt_getkey(int timeoffs, unsigned char *key, int keylen)
 	reftime = time(NULL) + timeoffs;
 	tp = localtime(&reftime);
 
-	ctxt = PPP_MD_CTX_new();
+	ctxt = srp_sha1_ctx();
 	if (ctxt) {
 
 	    strftime(tbuf, sizeof (tbuf), "%Y%m%d", tp);
@@ -352,7 +453,6 @@ pncrypt_getkey(int timeoffs, unsigned char *key, int keylen)
 	    PPP_DigestUpdate(ctxt, tbuf, strlen(tbuf));
 	    PPP_DigestFinal(ctxt, key, &keylen);
 
-	    PPP_MD_CTX_free(ctxt);
 	    return 1;
 	}
 
@@ -442,9 +542,7 @@ eap_figure_next_state(eap_state *esp, int status)
 {
 #ifdef PPP_WITH_SRP
 	unsigned char secbuf[MAXWORDLEN], clear[8], *sp, *dp, key[SHA_DIGEST_LENGTH];
-	struct t_pw tpw;
-	struct t_confent *tce, mytce;
-	char *cp, *cp2;
+	struct srp_verifier_cache *vc;
 	struct t_server *ts;
 	int id, i, plen, clen, toffs, keylen;
 	u_char vals[2];
@@ -540,18 +638,10 @@ eap_figure_next_state(eap_state *esp, int status)
 		    esp->es_server.ea_name, (char *)secbuf, 1) != 0) {
 			/* Set up default in case SRP entry is bad */
 			esp->es_server.ea_state = eapMD5Chall;
-			/* Get t_confent based on index in srp-secrets */
-			id = strtol((char *)secbuf, &cp, 10);
-			if (*cp++ != ':' || id < 0)
+			/* Get verifier and t_confent from the entry */
+			if ((vc = srp_get_verifier((char *)secbuf)) == NULL)
 				break;
-			if (id == 0) {
-				mytce.index = 0;
-				mytce.modulus.data = (u_char *)wkmodulus;
-				mytce.modulus.len = sizeof (wkmodulus);
-				mytce.generator.data = (u_char *)"\002";
-				mytce.generator.len = 1;
-				tce = &mytce;
-			} else if ((tce = gettcid(id)) != NULL) {
+			if (vc->tce.index != 0) {
 				/*
 				 * Client will have to verify this modulus/
 				 * generator combination, and that will take
@@ -560,20 +650,9 @@ eap_figure_next_state(eap_state *esp, int status)
 				if (esp->es_server.ea_timeout > 0 &&
 				    esp->es_server.ea_timeout < 30)
 					esp->es_server.ea_timeout = 30;
-			} else {
-				break;
 			}
-			if ((cp2 = strchr(cp, ':')) == NULL)
-				break;
-			*cp2++ = '\0';
-			tpw.pebuf.name = esp->es_server.ea_peer;
-			tpw.pebuf.password.len = t_fromb64((char *)tpw.pwbuf,
-			    cp);
-			tpw.pebuf.password.data = (char*) tpw.pwbuf;
-			tpw.pebuf.salt.len = t_fromb64((char *)tpw.saltbuf,
-			    cp2);
-			tpw.pebuf.salt.data = tpw.saltbuf;
-			if ((ts = t_serveropenraw(&tpw.pebuf, tce)) == NULL)
+			vc->tpw.pebuf.name = esp->es_server.ea_peer;
+			if ((ts = t_serveropenraw(&vc->tpw.pebuf, &vc->tce)) == NULL)
 				break;
 			esp->es_server.ea_session = (void *)ts;
 			esp->es_server.ea_state = eapSRP1;
@@ -1035,7 +1114,7 @@ eap_send_request(eap_state *esp)
 			}
 
 			/* Obscure the pseudonym with SHA1 hash */
-			ctxt = PPP_MD_CTX_new();
+			ctxt = srp_sha1_ctx();
 			if (ctxt) {
 
 				PPP_DigestInit(ctxt, PPP_sha1());
@@ -1058,8 +1137,6 @@ eap_send_request(eap_state *esp)
 					PPP_DigestUpdate(ctxt, optr - SHA_DIGEST_LENGTH,
 						SHA_DIGEST_LENGTH);
 				}
-
-				PPP_MD_CTX_free(ctxt);
 			}
 		}
 		break;
@@ -1278,6 +1355,12 @@ eap_lowerdown(int unit)
 
 	esp->es_client.ea_state = esp->es_server.ea_state = eapInitial;
 	esp->es_client.ea_requests = esp->es_server.ea_requests = 0;
+#ifdef PPP_WITH_SRP
+	if (srp_ctxt != NULL) {
+		PPP_MD_CTX_free(srp_ctxt);
+		srp_ctxt = NULL;
+	}
+#endif /* PPP_WITH_SRP */
 }
 
 /*
@@ -1579,7 +1662,7 @@ write_pseudonym(eap_state *esp, u_char *inp, int len, int id)
 			dsize = SHA_DIGEST_LENGTH;
 		len -= dsize;
 		datp = inp + len;
-		ctxt = PPP_MD_CTX_new();
+		ctxt = srp_sha1_ctx();
 		if (ctxt) {
 
 			PPP_DigestInit(ctxt, PPP_sha1());
@@ -1596,8 +1679,6 @@ write_pseudonym(eap_state *esp, u_char *inp, int len, int id)
 
 			for (digp = dig; digp < dig + SHA_DIGEST_LENGTH; digp++)
 				*datp++ ^= *digp;
-
-			PPP_MD_CTX_free(ctxt);
 		}
 	}
 
@@ -2134,7 +2215,7 @@ eap_request(eap_state *esp, u_char *inp, int id, int len)
 				warn("EAP: malformed Lightweight rechallenge");
 				return;
 			}
-			ctxt = PPP_MD_CTX_new();
+			ctxt = srp_sha1_ctx();
 			if (ctxt) {
 
 				vals[0] = id;
@@ -2147,8 +2228,6 @@ eap_request(eap_state *esp, u_char *inp, int id, int len)
 					esp->es_client.ea_namelen);
 				PPP_DigestFinal(ctxt, dig, &diglen);
 
-				PPP_MD_CTX_free(ctxt);
-
 				eap_srp_response(esp, id, EAPSRP_LWRECHALLENGE, dig,
 					SHA_DIGEST_LENGTH);
 			}
@@ -2790,7 +2869,7 @@ eap_response(eap_state *esp, u_char *inp, int id, int len)
 				    "response");
 				return;
 			}
-			ctxt = PPP_MD_CTX_new();
+			ctxt = srp_sha1_ctx();
 			if (ctxt) {
 				vallen = id;
 
@@ -2803,8 +2882,6 @@ eap_response(eap_state *esp, u_char *inp, int id, int len)
 					esp->es_server.ea_peerlen);
 				PPP_DigestFinal(ctxt, dig, &diglen);
 
-				PPP_MD_CTX_free(ctxt);
-
 				if (BCMP(dig, inp, SHA_DIGEST_LENGTH) != 0) {
 					error("EAP: failed Lightweight rechallenge");
 					eap_send_failure(esp);
@@ -66,6 +66,7 @@ static void fsm_rtermreq (fsm *, int, u_char *, int);
 static void fsm_rtermack (fsm *);
 static void fsm_rcoderej (fsm *, u_char *, int);
 static void fsm_sconfreq (fsm *, int);
+static void fsm_opened (fsm *);
 
 #define PROTO_NAME(f)	((f)->callbacks->proto_name)
 
@@ -88,6 +89,8 @@ fsm_init(fsm *f)
     f->maxtermtransmits = DEFMAXTERMREQS;
     f->maxnakloops = DEFMAXNAKLOOPS;
     f->term_reason_len = 0;
+    f->creq_sent = 0;
+    f->creq_retransmits = 0;
 }
 
 
@@ -97,6 +100,9 @@ fsm_init(fsm *f)
 void
 fsm_lowerup(fsm *f)
 {
+    f->creq_sent = 0;
+    f->creq_retransmits = 0;
+
     switch( f->state ){
     case INITIAL:
 	f->state = CLOSED;
@@ -445,9 +451,7 @@ fsm_rconfreq(fsm *f, int id, u_char *inp, int len)
     if (code == CONFACK) {
 	if (f->state == ACKRCVD) {
 	    UNTIMEOUT(fsm_timeout, f);	/* Cancel timeout */
-	    f->state = OPENED;
-	    if (f->callbacks->up)
-		(*f->callbacks->up)(f);	/* Inform upper layers */
+	    fsm_opened(f);
 	} else
 	    f->state = ACKSENT;
 	f->nakloops = 0;
@@ -462,6 +466,20 @@ fsm_rconfreq(fsm *f, int id, u_char *inp, int len)
 }
 
 
+/*
+ * fsm_opened - Negotiation has completed; enter the OPENED state.
+ */
+static void
+fsm_opened(fsm *f)
+{
+    f->state = OPENED;
+    FSMDEBUG(("%s: opened after %d Configure-Request(s), %d retransmitted",
+	      PROTO_NAME(f), f->creq_sent, f->creq_retransmits));
+    if (f->callbacks->up)
+	(*f->callbacks->up)(f);	/* Inform upper layers */
+}
+
+
 /*
  * fsm_rconfack - Receive Configure-Ack.
  */
@@ -499,10 +517,8 @@ fsm_rconfack(fsm *f, int id, u_char *inp, int len)
 
     case ACKSENT:
 	UNTIMEOUT(fsm_timeout, f);	/* Cancel timeout */
-	f->state = OPENED;
 	f->retransmits = f->maxconfreqtransmits;
-	if (f->callbacks->up)
-	    (*f->callbacks->up)(f);	/* Inform upper layers */
+	fsm_opened(f);
 	break;
 
     case OPENED:
@@ -727,7 +743,8 @@ fsm_sconfreq(fsm *f, int retransmit)
 	/* New request - reset retransmission counter, use new ID */
 	f->retransmits = f->maxconfreqtransmits;
 	f->reqid = ++f->id;
-    }
+    } else
+	++f->creq_retransmits;
 
     f->seen_ack = 0;
 
@@ -743,6 +760,7 @@ fsm_sconfreq(fsm *f, int retransmit)
 	    (*f->callbacks->addci)(f, outp, &cilen);
     } else
 	cilen = 0;
+    ++f->creq_sent;
 
     /* send the request to our peer */
     fsm_sdata(f, CONFREQ, f->reqid, outp, cilen);
@@ -88,6 +88,8 @@ typedef struct fsm {
     struct fsm_callbacks *callbacks;	/* Callback routines */
     char *term_reason;		/* Reason for closing protocol */
     int term_reason_len;	/* Length of term_reason */
+    int creq_sent;		/* Configure-Requests sent */
+    int creq_retransmits;	/* of which were retransmissions */
 } fsm;
 
 
@@ -215,6 +215,10 @@ lcp_options lcp_hisoptions[NUM_PPP];	/* Options that we ack'd */
 static int lcp_echos_pending = 0;	/* Number of outstanding echo msgs */
 static int lcp_echo_number   = 0;	/* ID number of next echo frame */
 static int lcp_echo_timer_running = 0;  /* set if a timer is running */
+static unsigned int lcp_echoreq_sent;	/* echo-requests we sent */
+static unsigned int lcp_echoreq_skipped; /* echo-requests not needed */
+static unsigned int lcp_echorep_rcvd;	/* echo-replies from the peer */
+static unsigned int lcp_echoreq_rcvd;	/* echo-requests we answered */
 static int lcp_rtt_file_fd = 0;		/* fd for the opened LCP RTT file */
 static u_int32_t *lcp_rtt_buffer = NULL; /* the mmap'ed LCP RTT file */
 
@@ -525,6 +529,7 @@ lcp_extcode(fsm *f, int code, int id, u_char *inp, int len)
     case ECHOREQ:
 	if (f->state != OPENED)
 	    break;
+	++lcp_echoreq_rcvd;
 	magp = inp;
 	PUTLONG(lcp_gotoptions[f->unit].magicnumber, magp);
 	fsm_sdata(f, ECHOREP, id, inp, len);
@@ -2332,6 +2337,7 @@ lcp_received_echo_reply (fsm *f, int id, u_char *inp, int len)
 	warn("appear to have received our own echo-reply!");
 	return;
     }
+    ++lcp_echorep_rcvd;
 
     if (lcp_rtt_file_fd && len >= 16) {
 	long lcp_rtt_magic;
@@ -2383,7 +2389,9 @@ LcpSendEchoRequest (fsm *f)
 
     /*
      * If adaptive echos have been enabled, only send the echo request if
-     * no traffic was received since the last one.
+     * no traffic was received since the last one.  The kernel counts
+     * LCP frames in pkts_in, so an echo-request from the peer counts as
+     * traffic too.
      */
     if (lcp_echo_adaptive) {
 	static unsigned int last_pkts_in = 0;
@@ -2393,6 +2401,7 @@ LcpSendEchoRequest (fsm *f)
 	    last_pkts_in = cur_stats.pkts_in;
 	    /* receipt of traffic indicates the link is working... */
 	    lcp_echos_pending = 0;
+	    ++lcp_echoreq_skipped;
 	    return;
 	}
     }
@@ -2417,6 +2426,7 @@ LcpSendEchoRequest (fsm *f)
 
         fsm_sdata(f, ECHOREQ, lcp_echo_number++ & 0xFF, pkt, pktp - pkt);
 	++lcp_echos_pending;
+	++lcp_echoreq_sent;
     }
 }
 
@@ -2484,6 +2494,10 @@ lcp_echo_lowerup (int unit)
     lcp_echos_pending      = 0;
     lcp_echo_number        = 0;
     lcp_echo_timer_running = 0;
+    lcp_echoreq_sent       = 0;
+    lcp_echoreq_skipped    = 0;
+    lcp_echorep_rcvd       = 0;
+    lcp_echoreq_rcvd       = 0;
 
     /* Open the file where the LCP RTT data will be logged */
     lcp_rtt_open_file();
@@ -2507,6 +2521,11 @@ lcp_echo_lowerdown (int unit)
         lcp_echo_timer_running = 0;
     }
 
+    if (lcp_echoreq_sent || lcp_echoreq_skipped || lcp_echoreq_rcvd)
+	dbglog("LCP echo: sent %u requests (%u skipped), got %u replies,"
+	       " answered %u requests", lcp_echoreq_sent, lcp_echoreq_skipped,
+	       lcp_echorep_rcvd, lcp_echoreq_rcvd);
+
     /* Close the file containing the LCP RTT data */
     lcp_rtt_close_file();
 }
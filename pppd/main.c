@@ -66,6 +66,8 @@
  * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#define _GNU_SOURCE 1		/* for POSIX_SPAWN_SETSID */
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -94,6 +96,9 @@
 #include <limits.h>
 #include <inttypes.h>
 #include <net/if.h>
+#ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP
+#include <spawn.h>
+#endif
 
 #include "pppd-private.h"
 #include "options.h"
@@ -164,6 +169,7 @@ int (*holdoff_hook)(void) = NULL;
 int (*new_phase_hook)(int) = NULL;
 void (*snoop_recv_hook)(unsigned char *p, int len) = NULL;
 void (*snoop_send_hook)(unsigned char *p, int len) = NULL;
+int (*script_hook)(const struct ppp_script *) = NULL;
 
 static int conn_running;	/* we have a [dis]connector running */
 static int fd_loop;		/* fd for getting demand-dial packets */
@@ -223,6 +229,7 @@ struct subprocess {
     void	(*done)(void *);
     void	*arg;
     int		killable;
+    struct timeval start;	/* when it was started */
     struct subprocess *next;
 };
 
@@ -425,6 +432,8 @@ main(int argc, char *argv[])
      */
     tty_init();
 
+    trace_init();
+
     progname = *argv;
 
     /*
@@ -544,6 +553,8 @@ main(int argc, char *argv[])
 
     setup_signals();
 
+    trace_start();
+
     create_linkpidfile(getpid());
 
     waiting = 0;
@@ -696,6 +707,7 @@ handle_events(void)
     waiting = 0;
     remove_fd(sigpipe[0]);
 
+    trace_check();
     calltimeout();
     if (got_sighup) {
 	info("Hangup (SIGHUP)");
@@ -1299,6 +1311,8 @@ die(int status)
 
     if (!mp_on() || mp_master())
 	print_link_stats();
+    if (status != EXIT_OK && status != EXIT_USER_REQUEST)
+	trace_log();
     cleanup();
     notify(exitnotify, status);
     syslog(LOG_INFO, "Exit.");
@@ -1319,6 +1333,7 @@ cleanup(void)
     if (the_channel->cleanup)
 	(*the_channel->cleanup)();
     remove_pidfiles();
+    trace_cleanup();
 
 #ifdef PPP_WITH_TDB
     if (pppdb != NULL)
@@ -1905,13 +1920,88 @@ update_script_environment(void)
     }
 }
 
+#ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP
+/*
+ * spawn_program - start a script with posix_spawn.
+ *
+ * Forking pppd duplicates its whole address space only for the child
+ * to throw it away again at exec, which gets expensive when many pppd
+ * processes run scripts at once.  posix_spawn lets libc use vfork-style
+ * process creation instead.  That is only possible when the child
+ * doesn't need to run any of our code, i.e. when no plugin wants a
+ * fork notification, no user environment changes need applying and we
+ * are already running with the real uid/gid the script should get.
+ * Returns the pid, -1 if the program has disappeared since it was
+ * checked, or 0 if the caller should use ppp_safe_fork instead.  That
+ * includes spawn failures, so that the forked child reports the exec
+ * error and gets reaped like any other script.
+ */
+static int
+spawn_program(char *prog, char * const *args, int must_exist)
+{
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_t attr;
+    mode_t mask;
+    pid_t pid;
+    int err;
+
+    if (fork_notifier != NULL || userenv_list != NULL
+	|| getuid() != 0 || getgid() != getegid())
+	return 0;
+
+    if (posix_spawn_file_actions_init(&fa) != 0)
+	return 0;
+    if (posix_spawnattr_init(&attr) != 0) {
+	posix_spawn_file_actions_destroy(&fa);
+	return 0;
+    }
+    err = posix_spawn_file_actions_adddup2(&fa, fd_devnull, 0);
+    if (err == 0)
+	err = posix_spawn_file_actions_adddup2(&fa, fd_devnull, 1);
+    if (err == 0)
+	err = posix_spawn_file_actions_adddup2(&fa, fd_devnull, 2);
+    if (err == 0)
+	err = posix_spawn_file_actions_addclosefrom_np(&fa, 3);
+#ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP
+    if (err == 0)
+	err = posix_spawn_file_actions_addchdir_np(&fa, "/");
+#else
+    err = -1;
+#endif
+    if (err == 0)
+	err = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID);
+    if (err != 0) {
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&fa);
+	return 0;
+    }
+
+    mask = umask(S_IRWXG|S_IRWXO);
+    err = posix_spawn(&pid, prog, &fa, &attr, args, script_env);
+    umask(mask);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&fa);
+
+    if (err == ENOENT) {
+	errno = err;
+	if (must_exist)
+	    warn("Can't execute %s: %m", prog);
+	return -1;
+    }
+    if (err != 0)
+	return 0;
+    return pid;
+}
+#endif
+
 /*
  * run_program - execute a program with given arguments,
  * but don't wait for it unless wait is non-zero.
  * If the program can't be executed, logs an error unless
  * must_exist is 0 and the program file doesn't exist.
  * Returns -1 if it couldn't fork, 0 if the file doesn't exist
- * or isn't an executable plain file, or the process ID of the child.
+ * or isn't an executable plain file or the script_hook handled it,
+ * or the process ID of the child.
  * If done != NULL, (*done)(arg) will be called later (within
  * reap_kids) iff the return value is > 0.
  */
@@ -1921,6 +2011,19 @@ run_program(char *prog, char * const *args, int must_exist, void (*done)(void *)
     int pid, status, ret;
     struct stat sbuf;
 
+    /*
+     * Give a plugin the chance to do the script's work in-process.
+     */
+    if (script_hook) {
+	struct ppp_script script = { prog, args, script_env };
+
+	if ((*script_hook)(&script)) {
+	    if (debug)
+		dbglog("Script %s handled by plugin", prog);
+	    return 0;
+	}
+    }
+
     /*
      * First check if the file exists and is executable.
      * We don't use access() because that would use the
@@ -1935,7 +2038,13 @@ run_program(char *prog, char * const *args, int must_exist, void (*done)(void *)
 	return 0;
     }
 
-    pid = ppp_safe_fork(fd_devnull, fd_devnull, fd_devnull);
+#ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP
+    pid = spawn_program(prog, args, must_exist);
+    if (pid < 0)
+	return 0;
+    if (pid == 0)
+#endif
+	pid = ppp_safe_fork(fd_devnull, fd_devnull, fd_devnull);
     if (pid == -1) {
 	error("Failed to create child process for %s: %m", prog);
 	return -1;
@@ -2012,6 +2121,7 @@ record_child(int pid, char *prog, void (*done)(void *), void *arg, int killable)
 	chp->arg = arg;
 	chp->next = children;
 	chp->killable = killable;
+	ppp_get_time(&chp->start);
 	children = chp;
     }
 }
@@ -2051,10 +2161,17 @@ forget_child(int pid, int status)
     if (WIFSIGNALED(status)) {
         warn("Child process %s (pid %d) terminated with signal %d",
 	     (chp? chp->prog: "??"), pid, WTERMSIG(status));
-    } else if (debug)
-        dbglog("Script %s finished (pid %d), status = 0x%x",
+    } else if (debug) {
+	struct timeval now;
+	long ms = -1;
+
+	if (chp && ppp_get_time(&now) == 0)
+	    ms = (now.tv_sec - chp->start.tv_sec) * 1000
+		+ (now.tv_usec - chp->start.tv_usec) / 1000;
+        dbglog("Script %s finished (pid %d), status = 0x%x, %ld ms",
 	       (chp? chp->prog: "??"), pid,
-	       WIFEXITED(status) ? WEXITSTATUS(status) : status);
+	       WIFEXITED(status) ? WEXITSTATUS(status) : status, ms);
+    }
     if (chp && chp->done)
         (*chp->done)(chp->arg);
     if (chp)
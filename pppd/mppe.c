@@ -200,6 +200,7 @@ mppe_set_chapv2(unsigned char *PasswordHashHash, unsigned char *NTResponse,
 	  0x6b, 0x65, 0x79, 0x2e };
     u_char *s;
 
+    /* One context, re-initialised for each of the three digests */
     ctx = PPP_MD_CTX_new();
     if (ctx != NULL) {
 
@@ -218,7 +219,6 @@ mppe_set_chapv2(unsigned char *PasswordHashHash, unsigned char *NTResponse,
             }
         }
         
-        PPP_MD_CTX_free(ctx);
     }
 
     /*
@@ -229,7 +229,6 @@ mppe_set_chapv2(unsigned char *PasswordHashHash, unsigned char *NTResponse,
     else
 	s = Magic2;
 
-    ctx = PPP_MD_CTX_new();
     if (ctx != NULL) {
 
         if (PPP_DigestInit(ctx, PPP_sha1())) {
@@ -250,7 +249,6 @@ mppe_set_chapv2(unsigned char *PasswordHashHash, unsigned char *NTResponse,
             }
         }
         
-        PPP_MD_CTX_free(ctx);
     }
 
 
@@ -262,7 +260,6 @@ mppe_set_chapv2(unsigned char *PasswordHashHash, unsigned char *NTResponse,
     else
 	s = Magic3;
 
-    ctx = PPP_MD_CTX_new();
     if (ctx != NULL) {
 
         if (PPP_DigestInit(ctx, PPP_sha1())) {
@@ -283,9 +280,9 @@ mppe_set_chapv2(unsigned char *PasswordHashHash, unsigned char *NTResponse,
             }
         }
         
-        PPP_MD_CTX_free(ctx);
     }
 
+    PPP_MD_CTX_free(ctx);
     mppe_set_keys(SendKey, RecvKey, SHA_DIGEST_LENGTH);
 }
 
@@ -77,6 +77,22 @@ static int time_left(struct timeval *diff, struct timeval *exp)
     return 1;
 }
 
+/* Best PADO seen so far when collecting offers (see waitForPADO) */
+static struct PADOOffer {
+    int valid;
+    unsigned char peerEth[ETH_ALEN];
+    PPPoETag cookie;
+    PPPoETag relayId;
+    int mtu;
+    int mru;
+    int seenMaxPayload;
+    char *acName;
+} bestOffer;
+
+/* The offer that gave us our last session, and on which interface */
+static struct PADOOffer lastOffer;
+static char lastOfferIfName[IFNAMSIZ];
+
 /**********************************************************************
 *%FUNCTION: parseForHostUniq
 *%ARGUMENTS:
@@ -372,6 +388,79 @@ sendPADI(PPPoEConnection *conn)
     sendPacket(conn, conn->discoverySocket, &packet, (int) (plen + HDR_SIZE));
 }
 
+/**********************************************************************
+*%FUNCTION: saveOffer
+*%ARGUMENTS:
+* conn -- PPPoEConnection structure, just filled in from a PADO
+* peer -- MAC address the PADO came from
+*%RETURNS:
+* 1 if this offer is better than any seen so far and was saved; 0 if not
+*%DESCRIPTION:
+* Keeps the best PADO while collecting offers.  An AC that lets us use a
+* bigger PPP-Max-Payload wins; otherwise the first (fastest) one does.
+***********************************************************************/
+static int
+saveOffer(PPPoEConnection *conn, unsigned char const *peer)
+{
+    int payload = conn->seenMaxPayload ? MIN(conn->mtu, conn->mru) : 0;
+
+    if (bestOffer.valid) {
+	int bestPayload = bestOffer.seenMaxPayload ?
+	    MIN(bestOffer.mtu, bestOffer.mru) : 0;
+	if (payload <= bestPayload)
+	    return 0;
+    }
+
+    bestOffer.valid = 1;
+    memcpy(bestOffer.peerEth, peer, ETH_ALEN);
+    memcpy(&bestOffer.cookie, &conn->cookie,
+	   ntohs(conn->cookie.length) + TAG_HDR_SIZE);
+    memcpy(&bestOffer.relayId, &conn->relayId,
+	   ntohs(conn->relayId.length) + TAG_HDR_SIZE);
+    bestOffer.mtu = conn->mtu;
+    bestOffer.mru = conn->mru;
+    bestOffer.seenMaxPayload = conn->seenMaxPayload;
+    free(bestOffer.acName);
+    bestOffer.acName = conn->actualACname ? strdup(conn->actualACname) : NULL;
+    return 1;
+}
+
+/**********************************************************************
+*%FUNCTION: useBestOffer
+*%ARGUMENTS:
+* conn -- PPPoEConnection structure
+*%RETURNS:
+* Nothing
+*%DESCRIPTION:
+* Puts the best offer collected by waitForPADO into conn, as though it
+* had been the only PADO received.
+***********************************************************************/
+static void
+useBestOffer(PPPoEConnection *conn)
+{
+    memcpy(conn->peerEth, bestOffer.peerEth, ETH_ALEN);
+    memcpy(&conn->cookie, &bestOffer.cookie,
+	   ntohs(bestOffer.cookie.length) + TAG_HDR_SIZE);
+    memcpy(&conn->relayId, &bestOffer.relayId,
+	   ntohs(bestOffer.relayId.length) + TAG_HDR_SIZE);
+    conn->mtu = bestOffer.mtu;
+    conn->mru = bestOffer.mru;
+    conn->seenMaxPayload = bestOffer.seenMaxPayload;
+    free(conn->actualACname);
+    conn->actualACname = bestOffer.acName;
+    bestOffer.acName = NULL;
+    bestOffer.valid = 0;
+    conn->discoveryState = STATE_RECEIVED_PADO;
+
+    if (pppoe_verbose >= 1) {
+	info("Chose AC %02x:%02x:%02x:%02x:%02x:%02x out of %d offers",
+	     (unsigned) conn->peerEth[0], (unsigned) conn->peerEth[1],
+	     (unsigned) conn->peerEth[2], (unsigned) conn->peerEth[3],
+	     (unsigned) conn->peerEth[4], (unsigned) conn->peerEth[5],
+	     conn->numPADOs);
+    }
+}
+
 /**********************************************************************
 *%FUNCTION: waitForPADO
 *%ARGUMENTS:
@@ -380,7 +469,10 @@ sendPADI(PPPoEConnection *conn)
 *%RETURNS:
 * Nothing
 *%DESCRIPTION:
-* Waits for a PADO packet and copies useful information
+* Waits for a PADO packet and copies useful information.  If
+* conn->padoWindow is set, keeps collecting PADOs for that many
+* milliseconds after the first acceptable one and then picks the best,
+* unless the AC we used last time answers, which is taken at once.
 ***********************************************************************/
 void
 waitForPADO(PPPoEConnection *conn, int timeout, int waitWholeTimeoutForPADO)
@@ -393,6 +485,9 @@ waitForPADO(PPPoEConnection *conn, int timeout, int waitWholeTimeoutForPADO)
     PPPoEPacket packet;
     int len;
 
+    int collecting = conn->padoWindow > 0 && !waitWholeTimeoutForPADO;
+    int mtu = conn->mtu, mru = conn->mru;
+
     struct PacketCriteria pc;
     pc.conn          = conn;
     pc.acNameOK      = (conn->acName)      ? 0 : 1;
@@ -410,7 +505,7 @@ waitForPADO(PPPoEConnection *conn, int timeout, int waitWholeTimeoutForPADO)
     do {
 	if (BPF_BUFFER_IS_EMPTY) {
 	    if (!time_left(&tv, &expire_at))
-		return;		/* Timed out */
+		break;		/* Timed out */
 
 	    FD_ZERO(&readable);
 	    FD_SET(conn->discoverySocket, &readable);
@@ -421,10 +516,10 @@ waitForPADO(PPPoEConnection *conn, int timeout, int waitWholeTimeoutForPADO)
 	    }
 	    if (r < 0) {
 		error("select (waitForPADO): %m");
-		return;
+		break;
 	    }
 	    if (r == 0)
-		return;		/* Timed out */
+		break;		/* Timed out */
 	}
 
 	conn->error = 0;
@@ -456,6 +551,18 @@ waitForPADO(PPPoEConnection *conn, int timeout, int waitWholeTimeoutForPADO)
 		warn("Ignoring PADO packet from wrong MAC address");
 		continue;
 	    }
+	    if (collecting) {
+		/* judge each offer on its own tags */
+		conn->mtu = mtu;
+		conn->mru = mru;
+		conn->seenMaxPayload = 0;
+		conn->cookie.type = conn->cookie.length = 0;
+		conn->relayId.type = conn->relayId.length = 0;
+		pc.acNameOK      = (conn->acName)      ? 0 : 1;
+		pc.serviceNameOK = (conn->serviceName) ? 0 : 1;
+		pc.seenACName    = 0;
+		pc.seenServiceName = 0;
+	    }
 	    if (parsePacket(&packet, parsePADOTags, &pc) < 0)
 		continue;
 	    if (conn->error)
@@ -479,12 +586,40 @@ waitForPADO(PPPoEConnection *conn, int timeout, int waitWholeTimeoutForPADO)
 		info("--------------------------------------------------");
 	    }
 	    conn->numPADOs++;
-	    if (pc.acNameOK && pc.serviceNameOK && conn->discoveryState != STATE_RECEIVED_PADO) {
+	    if (collecting && pc.acNameOK && pc.serviceNameOK) {
+		struct timeval window_end;
+
+		if (!bestOffer.valid && get_time(&window_end) == 0) {
+		    /* stop collecting padoWindow ms after the first offer */
+		    window_end.tv_sec += conn->padoWindow / 1000;
+		    window_end.tv_usec += (conn->padoWindow % 1000) * 1000;
+		    if (window_end.tv_usec >= 1000000) {
+			window_end.tv_usec -= 1000000;
+			++window_end.tv_sec;
+		    }
+		    if (window_end.tv_sec < expire_at.tv_sec
+			|| (window_end.tv_sec == expire_at.tv_sec
+			    && window_end.tv_usec < expire_at.tv_usec))
+			expire_at = window_end;
+		}
+		if (lastOffer.valid
+		    && !memcmp(packet.ethHdr.h_source, lastOffer.peerEth, ETH_ALEN)
+		    && !strcmp(conn->ifName, lastOfferIfName)) {
+		    /* the AC we used before is still there; take it */
+		    bestOffer.valid = 0;
+		    saveOffer(conn, packet.ethHdr.h_source);
+		    break;
+		}
+		saveOffer(conn, packet.ethHdr.h_source);
+	    } else if (pc.acNameOK && pc.serviceNameOK && conn->discoveryState != STATE_RECEIVED_PADO) {
 		memcpy(conn->peerEth, packet.ethHdr.h_source, ETH_ALEN);
 		conn->discoveryState = STATE_RECEIVED_PADO;
 	    }
 	}
-    } while (waitWholeTimeoutForPADO || conn->discoveryState != STATE_RECEIVED_PADO);
+    } while (waitWholeTimeoutForPADO || collecting || conn->discoveryState != STATE_RECEIVED_PADO);
+
+    if (bestOffer.valid)
+	useBestOffer(conn);
 }
 
 /***********************************************************************
@@ -662,6 +797,44 @@ waitForPADS(PPPoEConnection *conn, int timeout)
     }
 }
 
+/**********************************************************************
+*%FUNCTION: finishDiscovery
+*%ARGUMENTS:
+* conn -- PPPoE connection info structure, having just received a PADS
+*%RETURNS:
+* Nothing
+*%DESCRIPTION:
+* Completes discovery, and remembers the offer for discoveryResume()
+* and waitForPADO().
+***********************************************************************/
+static void
+finishDiscovery(PPPoEConnection *conn)
+{
+    if (!conn->seenMaxPayload) {
+	/* RFC 4638: MUST limit MTU/MRU to 1492 */
+	if (conn->mtu > ETH_PPPOE_MTU)
+	    conn->mtu = ETH_PPPOE_MTU;
+	if (conn->mru > ETH_PPPOE_MTU)
+	    conn->mru = ETH_PPPOE_MTU;
+    }
+
+    lastOffer.valid = 1;
+    memcpy(lastOffer.peerEth, conn->peerEth, ETH_ALEN);
+    memcpy(&lastOffer.cookie, &conn->cookie,
+	   ntohs(conn->cookie.length) + TAG_HDR_SIZE);
+    memcpy(&lastOffer.relayId, &conn->relayId,
+	   ntohs(conn->relayId.length) + TAG_HDR_SIZE);
+    lastOffer.mtu = conn->mtu;
+    lastOffer.mru = conn->mru;
+    lastOffer.seenMaxPayload = conn->seenMaxPayload;
+    strlcpy(lastOfferIfName, conn->ifName, sizeof(lastOfferIfName));
+
+    /* We're done. */
+    close(conn->discoverySocket);
+    conn->discoverySocket = -1;
+    conn->discoveryState = STATE_SESSION;
+}
+
 /**********************************************************************
 *%FUNCTION: discovery1
 *%ARGUMENTS:
@@ -722,17 +895,58 @@ discovery2(PPPoEConnection *conn)
 	timeout *= 2;
     } while (conn->discoveryState == STATE_SENT_PADR);
 
-    if (!conn->seenMaxPayload) {
-	/* RFC 4638: MUST limit MTU/MRU to 1492 */
-	if (conn->mtu > ETH_PPPOE_MTU)
-	    conn->mtu = ETH_PPPOE_MTU;
-	if (conn->mru > ETH_PPPOE_MTU)
-	    conn->mru = ETH_PPPOE_MTU;
+    finishDiscovery(conn);
+}
+
+/**********************************************************************
+*%FUNCTION: discoveryResume
+*%ARGUMENTS:
+* conn -- PPPoE connection info structure
+*%RETURNS:
+* 1 if a session was established; 0 if full discovery is needed
+*%DESCRIPTION:
+* Skips discovery phase 1 on reconnect by sending PADR straight to the
+* access concentrator that gave us our last session, with the same
+* cookie and relay ID.  Only one short attempt is made, since the AC
+* may have discarded the cookie; on failure conn is left ready for
+* discovery1().
+***********************************************************************/
+int
+discoveryResume(PPPoEConnection *conn)
+{
+    int mtu = conn->mtu, mru = conn->mru;
+
+    if (!lastOffer.valid || strcmp(conn->ifName, lastOfferIfName))
+	return 0;
+
+    memcpy(conn->peerEth, lastOffer.peerEth, ETH_ALEN);
+    memcpy(&conn->cookie, &lastOffer.cookie,
+	   ntohs(lastOffer.cookie.length) + TAG_HDR_SIZE);
+    memcpy(&conn->relayId, &lastOffer.relayId,
+	   ntohs(lastOffer.relayId.length) + TAG_HDR_SIZE);
+    conn->seenMaxPayload = lastOffer.seenMaxPayload;
+    if (conn->mtu > lastOffer.mtu)
+	conn->mtu = lastOffer.mtu;
+    if (conn->mru > lastOffer.mru)
+	conn->mru = lastOffer.mru;
+
+    conn->discoveryState = STATE_RECEIVED_PADO;
+    sendPADR(conn);
+    conn->discoveryState = STATE_SENT_PADR;
+    waitForPADS(conn, 1);
+
+    if (conn->discoveryState != STATE_SESSION) {
+	info("No PADS from previous access concentrator, doing full discovery");
+	lastOffer.valid = 0;
+	conn->mtu = mtu;
+	conn->mru = mru;
+	conn->seenMaxPayload = 0;
+	conn->cookie.type = conn->cookie.length = 0;
+	conn->relayId.type = conn->relayId.length = 0;
+	conn->discoveryState = STATE_SENT_PADI;
+	return 0;
     }
 
-    /* We're done. */
-    close(conn->discoverySocket);
-    conn->discoverySocket = -1;
-    conn->discoveryState = STATE_SESSION;
-    return;
+    finishDiscovery(conn);
+    return 1;
 }
@@ -50,6 +50,10 @@ static char const RCSID[] =
 #include <net/if_arp.h>
 #endif
 
+#ifdef HAVE_STRUCT_SOCKADDR_LL
+#include <linux/filter.h>
+#endif
+
 /* Initialize frame types to RFC 2516 values.  Some broken peers apparently
    use different frame types... sigh... */
 
@@ -81,6 +85,46 @@ etherType(PPPoEPacket *packet)
     return type;
 }
 
+#if defined(HAVE_STRUCT_SOCKADDR_LL) && defined(SO_ATTACH_FILTER)
+/**********************************************************************
+*%FUNCTION: attachDiscoveryFilter
+*%ARGUMENTS:
+* fd -- discovery socket
+* hwaddr -- our hardware address
+*%RETURNS:
+* Nothing
+*%DESCRIPTION:
+* Attaches a socket filter so that the kernel only queues discovery
+* frames sent to our own MAC address.  Other hosts' broadcast PADIs and
+* anything else packetIsForMe() would throw away never wake us up.
+* Host-Uniq is still checked in userspace, since tags may come in any
+* order and a classic BPF program can't search for one.
+***********************************************************************/
+static void
+attachDiscoveryFilter(int fd, unsigned char const *hwaddr)
+{
+    UINT32_t mac_hi = ((UINT32_t) hwaddr[0] << 24) | (hwaddr[1] << 16) |
+	(hwaddr[2] << 8) | hwaddr[3];
+    UINT32_t mac_lo = (hwaddr[4] << 8) | hwaddr[5];
+    struct sock_filter insns[] = {
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, mac_hi, 0, 3),
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 4),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, mac_lo, 0, 1),
+	BPF_STMT(BPF_RET | BPF_K, sizeof(PPPoEPacket)),
+	BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    struct sock_fprog prog;
+
+    prog.len = sizeof(insns) / sizeof(insns[0]);
+    prog.filter = insns;
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+	/* not fatal, packetIsForMe() does the same check */
+	warn("Can't attach discovery filter for pppoe: %m");
+    }
+}
+#endif
+
 /**********************************************************************
 *%FUNCTION: openInterface
 *%ARGUMENTS:
@@ -193,6 +237,11 @@ openInterface(char const *ifname, UINT16_t type, unsigned char *hwaddr)
 	return -1;
     }
 
+#if defined(HAVE_STRUCT_SOCKADDR_LL) && defined(SO_ATTACH_FILTER)
+    if (hwaddr && type == Eth_PPPOE_Discovery)
+	attachDiscoveryFilter(fd, hwaddr);
+#endif
+
     return fd;
 }
 
@@ -69,6 +69,8 @@ unsigned char pppoe_reqd_mac_addr[6];
 static char *pppoe_host_uniq;
 static int pppoe_padi_timeout = PADI_TIMEOUT;
 static int pppoe_padi_attempts = MAX_PADI_ATTEMPTS;
+static int pppoe_pado_window = 0;
+static bool pppoe_fast_reconnect = 0;
 static char devnam[MAXNAMELEN];
 
 static int PPPoEDevnameHook(char *cmd, char **argv, int doit);
@@ -103,6 +105,11 @@ static struct option Options[] = {
       "Initial timeout for discovery packets in seconds" },
     { "pppoe-padi-attempts", o_int, &pppoe_padi_attempts,
       "Number of discovery attempts" },
+    { "pppoe-pado-window", o_int, &pppoe_pado_window,
+      "Time in ms to collect PADOs before choosing the best",
+      OPT_LIMITS, NULL, 10000, 0 },
+    { "pppoe-fast-reconnect", o_bool, &pppoe_fast_reconnect,
+      "Reconnect to the previous access concentrator without PADI", 1 },
     { NULL }
 };
 int (*OldDevnameHook)(char *cmd, char **argv, int doit) = NULL;
@@ -145,6 +152,7 @@ PPPOEConnectDevice(void)
 {
     struct sockaddr_pppox sp;
     struct ifreq ifr;
+    struct timeval start, end;
     int s;
     char remote_number[MAXNAMELEN];
 
@@ -215,22 +223,33 @@ PPPOEConnectDevice(void)
 	    error("Failed to create PPPoE discovery socket: %m");
 	    goto errout;
 	}
-	discovery1(conn, 0);
-	/* discovery1() may update conn->mtu and conn->mru */
-	lcp_allowoptions[0].mru = conn->mtu;
-	lcp_wantoptions[0].mru = conn->mru;
-	if (conn->discoveryState != STATE_RECEIVED_PADO) {
-	    error("Unable to complete PPPoE Discovery phase 1");
-	    goto errout;
-	}
-	discovery2(conn);
-	/* discovery2() may update conn->mtu and conn->mru */
-	lcp_allowoptions[0].mru = conn->mtu;
-	lcp_wantoptions[0].mru = conn->mru;
-	if (conn->discoveryState != STATE_SESSION) {
-	    error("Unable to complete PPPoE Discovery phase 2");
-	    goto errout;
+	ppp_get_time(&start);
+	if (pppoe_fast_reconnect && discoveryResume(conn)) {
+	    /* discoveryResume() may update conn->mtu and conn->mru */
+	    lcp_allowoptions[0].mru = conn->mtu;
+	    lcp_wantoptions[0].mru = conn->mru;
+	} else {
+	    discovery1(conn, 0);
+	    /* discovery1() may update conn->mtu and conn->mru */
+	    lcp_allowoptions[0].mru = conn->mtu;
+	    lcp_wantoptions[0].mru = conn->mru;
+	    if (conn->discoveryState != STATE_RECEIVED_PADO) {
+		error("Unable to complete PPPoE Discovery phase 1");
+		goto errout;
+	    }
+	    discovery2(conn);
+	    /* discovery2() may update conn->mtu and conn->mru */
+	    lcp_allowoptions[0].mru = conn->mtu;
+	    lcp_wantoptions[0].mru = conn->mru;
+	    if (conn->discoveryState != STATE_SESSION) {
+		error("Unable to complete PPPoE Discovery phase 2");
+		goto errout;
+	    }
 	}
+	ppp_get_time(&end);
+	dbglog("PPPoE discovery took %ld ms",
+	       (long) ((end.tv_sec - start.tv_sec) * 1000
+		       + (end.tv_usec - start.tv_usec) / 1000));
     }
 
     /* Set PPPoE session-number for further consumption */
@@ -476,6 +495,7 @@ void pppoe_check_options(void)
 
     conn->discoveryTimeout = pppoe_padi_timeout;
     conn->discoveryAttempts = pppoe_padi_attempts;
+    conn->padoWindow = pppoe_pado_window;
 }
 
 struct channel pppoe_channel = {
@@ -237,6 +237,7 @@ typedef struct PPPoEConnectionStruct {
     int error;			/* Error packet received */
     int discoveryTimeout;       /* Timeout for discovery packets */
     int discoveryAttempts;      /* Number of discovery attempts */
+    int padoWindow;		/* ms to collect PADOs before choosing, or 0 */
     int seenMaxPayload;
     int storedmtu;		/* Stored MTU */
     int storedmru;		/* Stored MRU */
@@ -275,6 +276,7 @@ UINT16_t computeTCPChecksum(unsigned char *ipHdr, unsigned char *tcpHdr);
 UINT16_t pppFCS16(UINT16_t fcs, unsigned char *cp, int len);
 void discovery1(PPPoEConnection *conn, int waitWholeTimeoutForPADO);
 void discovery2(PPPoEConnection *conn);
+int discoveryResume(PPPoEConnection *conn);
 unsigned char *findTag(PPPoEPacket *packet, UINT16_t tagType,
 		       PPPoETag *tag);
 
@@ -234,61 +234,115 @@ char * base64_encode(const char *data)
 	return result;
 }
 
-unsigned int run_ntlm_auth(const char *username, 
-			   const char *domain, 
-			   const char *full_username,
-			   const char *plaintext_password,
-			   const u_char *challenge,
-			   size_t challenge_length,
-			   const u_char *lm_response, 
-			   size_t lm_response_length,
-			   const u_char *nt_response, 
-			   size_t nt_response_length,
-			   u_char nt_key[16], 
-			   char **error_string) 
+/*
+ * The ntlm_auth helper is started once and kept running for the life
+ * of pppd.  With --helper-protocol=ntlm-server-1 it answers any number
+ * of requests, each terminated by a line containing only ".", so
+ * rechallenges and later authentications don't pay for a fork and
+ * exec each time.  A helper which exits after answering is restarted
+ * on the next request.
+ */
+static pid_t ntlm_helper_pid = -1;
+static FILE *ntlm_helper_in;	/* requests to the helper */
+static FILE *ntlm_helper_out;	/* responses from the helper */
+
+/* Latency statistics for the running helper */
+static unsigned int ntlm_helper_requests;
+static long ntlm_helper_total_ms;
+static long ntlm_helper_max_ms;
+
+/**********************************************************************
+* %FUNCTION: stop_ntlm_helper
+* %ARGUMENTS:
+*  None
+* %RETURNS:
+*  Nothing
+* %DESCRIPTION:
+*  Closes the pipes to the ntlm_auth helper, which makes it exit, and
+*  reaps it.
+***********************************************************************/
+static void
+stop_ntlm_helper(void)
 {
-	
-	pid_t forkret;
-        int child_in[2];
-        int child_out[2];
 	int status;
 
-	int authenticated = NOT_AUTHENTICATED; /* not auth */
-	int got_user_session_key = 0; /* not got key */
+	if (ntlm_helper_pid < 0)
+		return;
+
+	if (ntlm_helper_requests)
+		dbglog("ntlm_auth helper (pid %d) answered %u requests, "
+		       "average %ld ms, max %ld ms", ntlm_helper_pid,
+		       ntlm_helper_requests,
+		       ntlm_helper_total_ms / ntlm_helper_requests,
+		       ntlm_helper_max_ms);
+
+	if (ntlm_helper_in != NULL && fclose(ntlm_helper_in) == EOF)
+		notice("error closing pipe?!? for child IN[1]");
+	if (ntlm_helper_out != NULL && fclose(ntlm_helper_out) == EOF)
+		notice("error closing pipe?!? for child OUT[0]");
+	ntlm_helper_in = NULL;
+	ntlm_helper_out = NULL;
+
+	while (waitpid(ntlm_helper_pid, &status, 0) == -1 && errno == EINTR
+	       && !ppp_signaled(SIGTERM))
+		;
+	ntlm_helper_pid = -1;
+}
 
-	char buffer[1024];
+static void
+ntlm_helper_exit_notify(void *arg, int val)
+{
+	stop_ntlm_helper();
+}
 
-	FILE *pipe_in;
-	FILE *pipe_out;
-	
-	int i;
-	char *challenge_hex;
-	char *lm_hex_hash;
-	char *nt_hex_hash;
+/**********************************************************************
+* %FUNCTION: start_ntlm_helper
+* %ARGUMENTS:
+*  error_string -- set to an error message on failure, if not NULL
+* %RETURNS:
+*  1 if the helper is running, 0 otherwise
+* %DESCRIPTION:
+*  Forks and executes the ntlm_auth helper with pipes to its stdin
+*  and stdout, unless it is already running.
+***********************************************************************/
+static int
+start_ntlm_helper(char **error_string)
+{
+	static int notify_added;
+	pid_t forkret;
+	int child_in[2];
+	int child_out[2];
 
-	/* First see if we have a program to run... */
-	if (ntlm_auth == NULL)
-		return NOT_AUTHENTICATED;
+	if (ntlm_helper_pid >= 0)
+		return 1;
 
-        /* Make first child */
-        if (pipe(child_out) == -1) {
-                error("pipe creation failed for child OUT!");
-		return NOT_AUTHENTICATED;
-        }
+	if (pipe(child_out) == -1) {
+		error("pipe creation failed for child OUT!");
+		return 0;
+	}
 
-        if (pipe(child_in) == -1) {
-                error("pipe creation failed for child IN!");
-		return NOT_AUTHENTICATED;
-        }
+	if (pipe(child_in) == -1) {
+		error("pipe creation failed for child IN!");
+		close(child_out[0]);
+		close(child_out[1]);
+		return 0;
+	}
 
-        forkret = ppp_safe_fork(child_in[0], child_out[1], 2);
-        if (forkret == -1) {
+	/* don't leak our ends of the pipes to scripts run later */
+	fcntl(child_in[1], F_SETFD, FD_CLOEXEC);
+	fcntl(child_out[0], F_SETFD, FD_CLOEXEC);
+
+	forkret = ppp_safe_fork(child_in[0], child_out[1], 2);
+	if (forkret == -1) {
 		if (error_string) {
 			*error_string = strdup("fork failed!");
 		}
-
-                return NOT_AUTHENTICATED;
-        }
+		close(child_in[0]);
+		close(child_in[1]);
+		close(child_out[0]);
+		close(child_out[1]);
+		return 0;
+	}
 
 	if (forkret == 0) {
 		/* child process */
@@ -311,17 +365,60 @@ unsigned int run_ntlm_auth(const char *username,
 		fatal("pppd/winbind: could not exec /bin/sh: %m");
 	}
 
-        /* parent */
+	/* parent */
 	close(child_out[1]);
 	close(child_in[0]);
 
-	/* Need to write the User's info onto the pipe */
-
-	pipe_in = fdopen(child_in[1], "w");
+	ntlm_helper_pid = forkret;
+	ntlm_helper_in = fdopen(child_in[1], "w");
+	ntlm_helper_out = fdopen(child_out[0], "r");
+	ntlm_helper_requests = 0;
+	ntlm_helper_total_ms = 0;
+	ntlm_helper_max_ms = 0;
+	if (ntlm_helper_in == NULL || ntlm_helper_out == NULL) {
+		if (ntlm_helper_in == NULL)
+			close(child_in[1]);
+		if (ntlm_helper_out == NULL)
+			close(child_out[0]);
+		stop_ntlm_helper();
+		return 0;
+	}
 
-	pipe_out = fdopen(child_out[0], "r");
+	if (!notify_added) {
+		ppp_add_notify(NF_EXIT, ntlm_helper_exit_notify, NULL);
+		notify_added = 1;
+	}
+	dbglog("started ntlm_auth helper (pid %d)", ntlm_helper_pid);
+	return 1;
+}
 
-	/* look for session key coming back */
+/**********************************************************************
+* %FUNCTION: send_ntlm_request
+* %ARGUMENTS:
+*  pipe_in -- stream to the ntlm_auth helper
+*  (remaining arguments as for run_ntlm_auth)
+* %RETURNS:
+*  1 if the whole request was written, 0 otherwise
+* %DESCRIPTION:
+*  Writes one request, terminated by ".", to the ntlm_auth helper.
+***********************************************************************/
+static int
+send_ntlm_request(FILE *pipe_in,
+		  const char *username, 
+		  const char *domain, 
+		  const char *full_username,
+		  const char *plaintext_password,
+		  const u_char *challenge,
+		  size_t challenge_length,
+		  const u_char *lm_response, 
+		  size_t lm_response_length,
+		  const u_char *nt_response, 
+		  size_t nt_response_length)
+{
+	int i;
+	char *challenge_hex;
+	char *lm_hex_hash;
+	char *nt_hex_hash;
 
 	if (username) {
 		char *b64_username = base64_encode(username);
@@ -380,72 +477,131 @@ unsigned int run_ntlm_auth(const char *username,
 	}
 	
 	fprintf(pipe_in, ".\n");
-	fflush(pipe_in);
-	
-	while (fgets(buffer, sizeof(buffer)-1, pipe_out) != NULL) {
-		char *message, *parameter;
-		if (buffer[strlen(buffer)-1] != '\n') {
-			break;
-		}
-		buffer[strlen(buffer)-1] = '\0';
-		message = buffer;
+	return fflush(pipe_in) == 0 && !ferror(pipe_in);
+}
 
-		if (!(parameter = strstr(buffer, ": "))) {
-			break;
-		}
+unsigned int run_ntlm_auth(const char *username, 
+			   const char *domain, 
+			   const char *full_username,
+			   const char *plaintext_password,
+			   const u_char *challenge,
+			   size_t challenge_length,
+			   const u_char *lm_response, 
+			   size_t lm_response_length,
+			   const u_char *nt_response, 
+			   size_t nt_response_length,
+			   u_char nt_key[16], 
+			   char **error_string) 
+{
+	int authenticated = NOT_AUTHENTICATED; /* not auth */
+	int got_user_session_key = 0; /* not got key */
+	int lines, complete, attempt;
+	struct timeval start, now;
+	long ms;
+
+	char buffer[1024];
+
+	/* First see if we have a program to run... */
+	if (ntlm_auth == NULL)
+		return NOT_AUTHENTICATED;
+
+	ppp_get_time(&start);
+
+	/*
+	 * If the helper has gone away since the last request, we only find
+	 * out when writing to it or reading its reply.  In that case start
+	 * a new one and try once more.
+	 */
+	for (attempt = 0; ; ++attempt) {
+		if (!start_ntlm_helper(error_string))
+			return NOT_AUTHENTICATED;
+
+		lines = 0;
+		complete = 0;
+		if (send_ntlm_request(ntlm_helper_in, username, domain,
+				      full_username, plaintext_password,
+				      challenge, challenge_length,
+				      lm_response, lm_response_length,
+				      nt_response, nt_response_length)) {
+			/* look for session key coming back */
+			while (fgets(buffer, sizeof(buffer)-1, ntlm_helper_out) != NULL) {
+				char *message, *parameter;
+				++lines;
+				if (buffer[strlen(buffer)-1] != '\n') {
+					break;
+				}
+				buffer[strlen(buffer)-1] = '\0';
+				message = buffer;
+
+				if (strcmp(message, ".") == 0) {
+					/* end of sequence */
+					complete = 1;
+					break;
+				}
+
+				if (!(parameter = strstr(buffer, ": "))) {
+					break;
+				}
 		
-		parameter[0] = '\0';
-		parameter++;
-		parameter[0] = '\0';
-		parameter++;
+				parameter[0] = '\0';
+				parameter++;
+				parameter[0] = '\0';
+				parameter++;
 		
-		if (strcmp(message, ".") == 0) {
-			/* end of sequence */
-			break;
-		} else if (strcasecmp(message, "Authenticated") == 0) {
-			if (strcasecmp(parameter, "Yes") == 0) {
-				authenticated = AUTHENTICATED;
-			} else {
-				notice("Winbind has declined authentication for user!");
-				authenticated = NOT_AUTHENTICATED;
-			}
-		} else if (strcasecmp(message, "User-session-key") == 0) {
-			/* length is the number of characters to parse */
-			if (nt_key) { 
-				if (strhex_to_str(nt_key, 32, parameter) == 16) {
-					got_user_session_key = 1;
+				if (strcasecmp(message, "Authenticated") == 0) {
+					if (strcasecmp(parameter, "Yes") == 0) {
+						authenticated = AUTHENTICATED;
+					} else {
+						notice("Winbind has declined authentication for user!");
+						authenticated = NOT_AUTHENTICATED;
+					}
+				} else if (strcasecmp(message, "User-session-key") == 0) {
+					/* length is the number of characters to parse */
+					if (nt_key) { 
+						if (strhex_to_str(nt_key, 32, parameter) == 16) {
+							got_user_session_key = 1;
+						} else {
+							notice("NT session key for user was not 16 bytes!");
+						}
+					}
+				} else if (strcasecmp(message, "Error") == 0) {
+					authenticated = NOT_AUTHENTICATED;
+					if (error_string)
+						*error_string = strdup(parameter);
+				} else if (strcasecmp(message, "Authentication-Error") == 0) {
+					authenticated = NOT_AUTHENTICATED;
+					if (error_string)
+						*error_string = strdup(parameter);
 				} else {
-					notice("NT session key for user was not 16 bytes!");
+					notice("unrecognised input from ntlm_auth helper - %s: %s", message, parameter); 
 				}
 			}
-		} else if (strcasecmp(message, "Error") == 0) {
-			authenticated = NOT_AUTHENTICATED;
-			if (error_string)
-				*error_string = strdup(parameter);
-		} else if (strcasecmp(message, "Authentication-Error") == 0) {
-			authenticated = NOT_AUTHENTICATED;
-			if (error_string)
-				*error_string = strdup(parameter);
-		} else {
-			notice("unrecognised input from ntlm_auth helper - %s: %s", message, parameter); 
 		}
+
+		if (complete)
+			break;
+
+		/*
+		 * The helper exited or sent something we couldn't parse, so
+		 * we can't tell where its next reply would start.  Don't
+		 * reuse it.
+		 */
+		stop_ntlm_helper();
+		if (lines > 0 || attempt > 0)
+			break;
 	}
 
-        /* parent */
-        if (fclose(pipe_out) == -1) {
-                fclose(pipe_in);
-                notice("error closing pipe?!? for child OUT[0]");
-                return NOT_AUTHENTICATED;
-        }
-
-       /* parent */
-        if (fclose(pipe_in) == -1) {
-                notice("error closing pipe?!? for child IN[1]");
-                return NOT_AUTHENTICATED;
-        }
-
-	while ((wait(&status) == -1) && errno == EINTR && !ppp_signaled(SIGTERM))
-                ;
+	if (ppp_get_time(&now) == 0) {
+		ms = (now.tv_sec - start.tv_sec) * 1000
+			+ (now.tv_usec - start.tv_usec) / 1000;
+		if (ntlm_helper_pid >= 0) {
+			++ntlm_helper_requests;
+			ntlm_helper_total_ms += ms;
+			if (ms > ntlm_helper_max_ms)
+				ntlm_helper_max_ms = ms;
+		}
+		dbglog("ntlm_auth helper request took %ld ms", ms);
+	}
 
 	if ((authenticated == AUTHENTICATED) && nt_key && !got_user_session_key) {
 		notice("Did not get user session key, despite being authenticated!");
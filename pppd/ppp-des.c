@@ -66,7 +66,7 @@ static int des_init(PPP_CIPHER_CTX *ctx, const unsigned char *key, const unsigne
                 memcpy(ctx->iv, iv, 8);
             }
 
-            if (EVP_CipherInit(cc, EVP_des_ecb(), ctx->key, ctx->iv, ctx->is_encr)) {
+            if (EVP_CipherInit(cc, PPP_EVP_ALG(des_ecb, EVP_des_ecb), ctx->key, ctx->iv, ctx->is_encr)) {
 
                 if (EVP_CIPHER_CTX_set_padding(cc, 0)) {
                     ctx->priv = cc;
@@ -50,13 +50,15 @@
 static int md4_init(PPP_MD_CTX *ctx)
 {
     if (ctx) {
-        EVP_MD_CTX *mctx = EVP_MD_CTX_new();
+        /* Reuse the EVP context if the last init was for the same digest */
+        EVP_MD_CTX *mctx = ctx->priv ? ctx->priv : EVP_MD_CTX_new();
         if (mctx) {
-            if (EVP_DigestInit(mctx, EVP_md4())) {
+            if (EVP_DigestInit_ex(mctx, PPP_EVP_ALG(md4, EVP_md4), NULL)) {
                 ctx->priv = mctx;
                 return 1;
             }
             EVP_MD_CTX_free(mctx);
+            ctx->priv = NULL;
         }
     }
     return 0;
@@ -386,7 +388,7 @@ MD4Final(unsigned char *buf, MD4_CTX *MD)
 static int md4_init(PPP_MD_CTX *ctx)
 {
     if (ctx) {
-        MD4_CTX *mctx = calloc(1, sizeof(MD4_CTX));
+        MD4_CTX *mctx = ctx->priv ? ctx->priv : calloc(1, sizeof(MD4_CTX));
         if (mctx) {
             MD4Init(mctx);
             ctx->priv = mctx;
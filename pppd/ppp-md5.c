@@ -49,13 +49,15 @@
 static int md5_init(PPP_MD_CTX *ctx)
 {
     if (ctx) {
-        EVP_MD_CTX *mctx = EVP_MD_CTX_new();
+        /* Reuse the EVP context if the last init was for the same digest */
+        EVP_MD_CTX *mctx = ctx->priv ? ctx->priv : EVP_MD_CTX_new();
         if (mctx) {
-            if (EVP_DigestInit((EVP_MD_CTX*) mctx, EVP_md5())) {
+            if (EVP_DigestInit_ex(mctx, PPP_EVP_ALG(md5, EVP_md5), NULL)) {
                 ctx->priv = mctx;
                 return 1;
             }
             EVP_MD_CTX_free(mctx);
+            ctx->priv = NULL;
         }
     }
     return 0;
@@ -405,7 +407,7 @@ static void Transform (UINT4 *buf, UINT4 *in)
 static int md5_init(PPP_MD_CTX *ctx)
 {
     if (ctx) {
-        MD5_CTX *md5 = calloc(1, sizeof(MD5_CTX));
+        MD5_CTX *md5 = ctx->priv ? ctx->priv : calloc(1, sizeof(MD5_CTX));
         if (md5 != NULL) {
             MD5_Init(md5);
             ctx->priv = md5;
@@ -51,13 +51,15 @@
 static int sha1_init(PPP_MD_CTX *ctx)
 {
     if (ctx) {
-        EVP_MD_CTX *mctx = EVP_MD_CTX_new();
+        /* Reuse the EVP context if the last init was for the same digest */
+        EVP_MD_CTX *mctx = ctx->priv ? ctx->priv : EVP_MD_CTX_new();
         if (mctx) {
-            if (EVP_DigestInit(mctx, EVP_sha1())) {
+            if (EVP_DigestInit_ex(mctx, PPP_EVP_ALG(sha1, EVP_sha1), NULL)) {
                 ctx->priv = mctx;
                 return 1;
             }
             EVP_MD_CTX_free(mctx);
+            ctx->priv = NULL;
         }
     }
     return 0;
@@ -266,7 +268,7 @@ SHA1_Final(unsigned char digest[20], SHA1_CTX *context)
 static int sha1_init(PPP_MD_CTX *ctx)
 {
     if (ctx) {
-        SHA1_CTX *mctx = calloc(1, sizeof(SHA1_CTX));
+        SHA1_CTX *mctx = ctx->priv ? ctx->priv : calloc(1, sizeof(SHA1_CTX));
         if (mctx) {
             SHA1_Init(mctx);
             ctx->priv = mctx;
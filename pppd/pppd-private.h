@@ -205,6 +205,7 @@ extern char	path_ipup[]; 	/* pathname of ip-up script */
 extern char	path_ipdown[];	/* pathname of ip-down script */
 extern char	path_ippreup[];	/* pathname of ip-pre-up script */
 extern char	req_ifname[]; /* interface name to use (IFNAMSIZ) */
+extern char	*unit_pool;	/* socket to get a ready-made ppp unit from */
 extern bool	multilink;	/* enable multilink operation (options.c) */
 extern bool	noendpoint;	/* don't send or accept endpt. discrim. */
 extern char	*bundle_name;	/* bundle name for multilink */
@@ -329,6 +330,17 @@ void unlock_db(void);
 /* Procedures exported from tty.c. */
 void tty_init(void);
 
+/* Procedures exported from trace.c. */
+void trace_init(void);		/* register trace options */
+void trace_packet(const char *, unsigned char *, int);
+				/* record a packet in the trace ring */
+void trace_dump(printer_func, void *);
+				/* decode the trace ring */
+void trace_log(void);		/* write the trace ring to the log */
+void trace_start(void);		/* open control socket, if any */
+void trace_check(void);		/* serve control socket requests */
+void trace_cleanup(void);	/* remove control socket */
+
 void print_string(char *, int,  printer_func, void *);
 				/* Format a string for output */
 ssize_t complete_read(int, void *, size_t);
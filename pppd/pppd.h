@@ -284,6 +284,9 @@ void fatal(const char *, ...);
 /* Say we ran out of memory, and die */
 void novm(const char *);
 
+/* Would a message at this syslog level be logged anywhere? */
+bool log_level_enabled(int);
+
 /* Format a packet and log it with syslog */
 void log_packet(unsigned char *, int, char *, int);
 
@@ -564,6 +567,14 @@ extern int  (*allowed_address_hook)(uint32_t addr);
 extern void (*snoop_recv_hook)(unsigned char *p, int len);
 extern void (*snoop_send_hook)(unsigned char *p, int len);
 
+/* Description of a script that pppd is about to run */
+struct ppp_script {
+    const char *prog;		/* pathname of the script */
+    char * const *argv;		/* arguments, argv[0] is prog */
+    char * const *envp;		/* environment it would get */
+};
+extern int  (*script_hook)(const struct ppp_script *script);
+
 #ifdef __cplusplus
 }
 #endif
@@ -167,6 +167,37 @@ static struct pam_conv pam_conv_data = {
     &conversation,
     NULL
 };
+
+/*
+ * PAM modules may wait on the network (LDAP, SSSD, ...), and all of
+ * pppd's timers, LCP echoes included, stall meanwhile.  Time each PAM
+ * call so that slow lookups show up in the log.
+ */
+#define PAM_SLOW_MS	1000
+
+static struct timeval pam_call_start;
+
+static void
+pam_timer_start(void)
+{
+    ppp_get_time(&pam_call_start);
+}
+
+static void
+pam_timer_end(const char *what)
+{
+    struct timeval now;
+    long ms;
+
+    if (ppp_get_time(&now) < 0)
+	return;
+    ms = (now.tv_sec - pam_call_start.tv_sec) * 1000
+	+ (now.tv_usec - pam_call_start.tv_usec) / 1000;
+    if (ms >= PAM_SLOW_MS)
+	warn("PAM %s took %ld ms", what, ms);
+    else
+	dbglog("PAM %s took %ld ms", what, ms);
+}
 #endif /* #ifdef PPP_WITH_PAM */
 
 int
@@ -212,7 +243,9 @@ session_start(const int flags, const char *user, const char *passwd, const char
     PAM_password = passwd;
 
     dbglog("Initializing PAM (%d) for user %s", flags, usr);
+    pam_timer_start();
     pam_error = pam_start (SERVICE_NAME, usr, &pam_conv_data, &pamh);
+    pam_timer_end("start");
     dbglog("---> PAM INIT Result = %d", pam_error);
     ok = (pam_error == PAM_SUCCESS);
 
@@ -223,7 +256,9 @@ session_start(const int flags, const char *user, const char *passwd, const char
 
     if (ok && (SESS_AUTH & flags)) {
         dbglog("Attempting PAM authentication");
+        pam_timer_start();
         pam_error = pam_authenticate (pamh, PAM_SILENT);
+        pam_timer_end("authentication");
         if (pam_error == PAM_SUCCESS) {
             /* PAM auth was OK */
             dbglog("PAM Authentication OK for %s", user);
@@ -244,7 +279,9 @@ session_start(const int flags, const char *user, const char *passwd, const char
 
     if (ok && (SESS_ACCT & flags)) {
         dbglog("Attempting PAM account checks");
+        pam_timer_start();
         pam_error = pam_acct_mgmt (pamh, PAM_SILENT);
+        pam_timer_end("account check");
         if (pam_error == PAM_SUCCESS) {
             /*
 	     * PAM account was OK, set the flag which indicates that we should
@@ -278,7 +315,9 @@ session_start(const int flags, const char *user, const char *passwd, const char
 
     if (ok && try_session && (SESS_ACCT & flags)) {
         /* Only open a session if the user's account was found */
+        pam_timer_start();
         pam_error = pam_open_session (pamh, PAM_SILENT);
+        pam_timer_end("open session");
         if (pam_error == PAM_SUCCESS) {
             dbglog("PAM Session opened for user %s", user);
             PAM_session = 1;
@@ -410,7 +449,11 @@ session_end(const char* ttyName)
     int pam_error = PAM_SUCCESS;
 
     if (pamh != NULL) {
-        if (PAM_session) pam_error = pam_close_session (pamh, PAM_SILENT);
+        if (PAM_session) {
+            pam_timer_start();
+            pam_error = pam_close_session (pamh, PAM_SILENT);
+            pam_timer_end("close session");
+        }
         PAM_session = 0;
         pam_end (pamh, pam_error);
         pamh = NULL;
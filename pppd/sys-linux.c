@@ -82,6 +82,7 @@
 #include <sys/utsname.h>
 #include <sys/sysmacros.h>
 #include <sys/param.h>
+#include <sys/un.h>
 
 #include <errno.h>
 #include <stddef.h>
@@ -210,6 +211,7 @@ static int master_fd = -1;	/* pty for old-style demand mode, master */
 #ifdef PPP_WITH_IPV6CP
 static int sock6_fd = -1;
 #endif /* PPP_WITH_IPV6CP */
+static int rtnl_conf_fd = -1;	/* netlink socket for interface config */
 
 /*
  * For the old-style kernel driver, this is the same as ppp_fd.
@@ -557,6 +559,8 @@ ppp_sys_close(void)
 	close(slave_fd);
     if (master_fd >= 0)
 	close(master_fd);
+    if (rtnl_conf_fd >= 0)
+	close(rtnl_conf_fd);
 }
 
 /********************************************************************
@@ -882,6 +886,83 @@ static int make_ppp_unit_rtnetlink(void)
     return 1;
 }
 
+/*
+ * get_pool_unit - get a /dev/ppp fd already attached to a ppp unit
+ * from the helper listening on the unit_pool socket.  The helper
+ * sends one byte with the fd attached as SCM_RIGHTS.
+ * Returns the fd, or -1 if the pool couldn't supply one.
+ */
+static int get_pool_unit(void)
+{
+	struct sockaddr_un sun;
+	struct timeval tv;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} control;
+	char c;
+	int s, fd, unit;
+
+	if (strlen(unit_pool) >= sizeof(sun.sun_path)) {
+		error("unit-pool socket name %s is too long", unit_pool);
+		return -1;
+	}
+	s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (s < 0) {
+		error("Couldn't create socket for unit pool: %m");
+		return -1;
+	}
+	tv.tv_sec = 2;
+	tv.tv_usec = 0;
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	strlcpy(sun.sun_path, unit_pool, sizeof(sun.sun_path));
+	if (connect(s, (struct sockaddr *) &sun, sizeof(sun)) < 0) {
+		warn("Couldn't connect to unit pool %s: %m", unit_pool);
+		close(s);
+		return -1;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	if (recvmsg(s, &msg, MSG_CMSG_CLOEXEC) != 1) {
+		warn("No reply from unit pool %s", unit_pool);
+		close(s);
+		return -1;
+	}
+	close(s);
+
+	fd = -1;
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		if (cmsg->cmsg_level == SOL_SOCKET
+		    && cmsg->cmsg_type == SCM_RIGHTS
+		    && cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	if (fd < 0) {
+		warn("Unit pool %s sent no file descriptor", unit_pool);
+		return -1;
+	}
+
+	/* it must be a /dev/ppp fd with a unit attached */
+	if (ioctl(fd, PPPIOCGUNIT, &unit) < 0) {
+		warn("Unit pool %s sent an unusable file descriptor: %m", unit_pool);
+		close(fd);
+		return -1;
+	}
+	ifunit = unit;
+	return fd;
+}
+
 /*
  * make_ppp_unit - make a new ppp unit for ppp_dev_fd.
  * Assumes new_style_driver.
@@ -894,6 +975,23 @@ static int make_ppp_unit(void)
 		dbglog("in make_ppp_unit, already had /dev/ppp open?");
 		close(ppp_dev_fd);
 	}
+
+	/*
+	 * A pooled unit has a kernel-chosen name and number, so don't
+	 * use the pool when the user asked for a particular one.
+	 */
+	if (unit_pool != NULL && req_unit == -1 && req_ifname[0] == '\0') {
+		ppp_dev_fd = get_pool_unit();
+		if (ppp_dev_fd >= 0) {
+			flags = fcntl(ppp_dev_fd, F_GETFL);
+			if (flags == -1
+			    || fcntl(ppp_dev_fd, F_SETFL, flags | O_NONBLOCK) == -1)
+				warn("Couldn't set /dev/ppp to nonblock: %m");
+			dbglog("Using unit %d from pool %s", ifunit, unit_pool);
+			return 0;
+		}
+	}
+
 	ppp_dev_fd = open("/dev/ppp", O_RDWR);
 	if (ppp_dev_fd < 0)
 		fatal("Couldn't open /dev/ppp: %m");
@@ -2110,6 +2208,118 @@ static int read_route_table(struct rtentry *rt)
     return 1;
 }
 
+/********************************************************************
+ *
+ * rtnetlink_getroute - ask the kernel for the route to a single
+ * destination with RTM_GETROUTE, rather than reading the whole
+ * routing table out of /proc, which is slow with large tables.
+ * With fib_match set, the kernel reports the matching route table
+ * entry (prefix length, metric) rather than the resolved route.
+ * `addr' is in network byte order, 4 bytes for AF_INET or 16 bytes
+ * for AF_INET6.
+ * Returns 1 and fills in *ri if the kernel returned a route, or -1
+ * if it didn't; callers then have to scan the routing table.
+ */
+
+struct rtnl_route_info {
+    int		type;		/* RTN_* route type */
+    int		table;		/* routing table id */
+    int		dst_len;	/* prefix length of the matching entry */
+    int		oif;		/* output interface index, or 0 */
+    int		priority;	/* route metric */
+    int		has_gateway;	/* gateway[] is valid */
+    unsigned char gateway[16];	/* gateway address */
+};
+
+static int rtnetlink_getroute(int family, const void *addr, int fib_match,
+			      struct rtnl_route_info *ri)
+{
+    struct {
+        struct nlmsghdr nlh;
+        struct rtmsg rtm;
+        struct {
+            struct rtattr rta;
+            unsigned char addr[16];
+        } dst;
+    } nlreq;
+    struct {
+        struct rtmsg rtm;
+        unsigned char attrs[1024];
+    } nlresp_data;
+    size_t nlresp_size;
+    struct rtattr *rta;
+    int alen, rtalen, resp;
+
+    alen = (family == AF_INET6)? 16: 4;
+
+    memset(&nlreq, 0, sizeof(nlreq));
+    nlreq.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(nlreq.rtm)) + RTA_SPACE(alen);
+    nlreq.nlh.nlmsg_type = RTM_GETROUTE;
+    nlreq.nlh.nlmsg_flags = NLM_F_REQUEST;
+    nlreq.rtm.rtm_family = family;
+    nlreq.rtm.rtm_dst_len = alen * 8;
+#ifdef RTM_F_FIB_MATCH
+    if (fib_match)
+        nlreq.rtm.rtm_flags = RTM_F_FIB_MATCH;
+#else
+    if (fib_match)
+        return -1;
+#endif
+    nlreq.dst.rta.rta_len = RTA_LENGTH(alen);
+    nlreq.dst.rta.rta_type = RTA_DST;
+    memcpy(nlreq.dst.addr, addr, alen);
+
+    nlresp_size = sizeof(nlresp_data);
+    resp = rtnetlink_msg("RTM_GETROUTE/NLM_F_REQUEST", &rtnl_conf_fd, &nlreq, nlreq.nlh.nlmsg_len, &nlresp_data, &nlresp_size, RTM_NEWROUTE);
+    if (resp < 0) {
+        /*
+         * Even ENETUNREACH doesn't mean the main table has no route:
+         * an unreachable rule, or rules that never reach the main
+         * table, give the same error.
+         */
+        return -1;
+    }
+    if (resp > 0) {
+        close(rtnl_conf_fd);
+        rtnl_conf_fd = -1;
+        return -1;
+    }
+    if (nlresp_size < NLMSG_ALIGN(sizeof(struct rtmsg)))
+        return -1;
+
+    memset(ri, 0, sizeof(*ri));
+    ri->type = nlresp_data.rtm.rtm_type;
+    ri->table = nlresp_data.rtm.rtm_table;
+    ri->dst_len = nlresp_data.rtm.rtm_dst_len;
+
+    rta = (struct rtattr *) ((char *) &nlresp_data + NLMSG_ALIGN(sizeof(struct rtmsg)));
+    rtalen = nlresp_size - NLMSG_ALIGN(sizeof(struct rtmsg));
+    for (; RTA_OK(rta, rtalen); rta = RTA_NEXT(rta, rtalen)) {
+        switch (rta->rta_type) {
+        case RTA_TABLE:
+            if (RTA_PAYLOAD(rta) >= sizeof(u_int32_t))
+                ri->table = *(u_int32_t *) RTA_DATA(rta);
+            break;
+        case RTA_OIF:
+            if (RTA_PAYLOAD(rta) >= sizeof(int))
+                ri->oif = *(int *) RTA_DATA(rta);
+            break;
+        case RTA_PRIORITY:
+            if (RTA_PAYLOAD(rta) >= sizeof(u_int32_t))
+                ri->priority = *(u_int32_t *) RTA_DATA(rta);
+            break;
+        case RTA_GATEWAY:
+            if (RTA_PAYLOAD(rta) >= alen) {
+                memcpy(ri->gateway, RTA_DATA(rta), alen);
+                ri->has_gateway = 1;
+            }
+            break;
+        }
+    }
+
+    return 1;
+}
+
 /********************************************************************
  *
  * defaultroute_exists - determine if there is a default route
@@ -2118,8 +2328,36 @@ static int read_route_table(struct rtentry *rt)
 
 static int defaultroute_exists (struct rtentry *rt, int metric)
 {
+    static char dev[IF_NAMESIZE];
+    struct rtnl_route_info ri;
+    u_int32_t dst = htonl(1);
     int result = 0;
 
+    /*
+     * Ask the kernel which table entry 0.0.0.1 matches (the kernel
+     * treats 0.0.0.0 itself as a local address).  That answers the
+     * question directly if it is the preferred default route in the
+     * main table; otherwise fall back to scanning the whole table.
+     */
+    if (rtnetlink_getroute(AF_INET, &dst, 1, &ri) > 0) {
+	if (ri.dst_len == 0 && ri.table == RT_TABLE_MAIN
+	    && ri.type == RTN_UNICAST && ri.oif > 0
+	    && (metric < 0 || ri.priority == metric)
+	    && if_indextoname(ri.oif, dev) != NULL) {
+	    memset(rt, 0, sizeof(*rt));
+	    SET_SA_FAMILY(rt->rt_dst, AF_INET);
+	    SET_SA_FAMILY(rt->rt_gateway, AF_INET);
+	    rt->rt_flags = RTF_UP;
+	    if (ri.has_gateway) {
+		memcpy(&SIN_ADDR(rt->rt_gateway), ri.gateway, 4);
+		rt->rt_flags |= RTF_GATEWAY;
+	    }
+	    rt->rt_metric = ri.priority;
+	    rt->rt_dev = dev;
+	    return 1;
+	}
+    }
+
     if (!open_route_table())
 	return 0;
 
@@ -2150,8 +2388,20 @@ static int defaultroute_exists (struct rtentry *rt, int metric)
 int have_route_to(u_int32_t addr)
 {
     struct rtentry rt;
+    struct rtnl_route_info ri;
+    u_int32_t dst = (addr != 0)? addr: htonl(1);	/* see above */
     int result = 0;
 
+    /*
+     * A single route lookup tells us the answer if it finds an
+     * ordinary route in the main table that doesn't go through our
+     * own interface; otherwise we have to look through the table.
+     */
+    if (rtnetlink_getroute(AF_INET, &dst, 0, &ri) > 0
+	&& ri.type == RTN_UNICAST && ri.table == RT_TABLE_MAIN && ri.oif > 0
+	&& (ifname[0] == 0 || ri.oif != if_nametoindex(ifname)))
+	return 1;
+
     if (!open_route_table())
 	return -1;		/* don't know */
 
@@ -2401,8 +2651,26 @@ static int read_route6_table(struct in6_rtmsg *rt)
 
 static int defaultroute6_exists (struct in6_rtmsg *rt, int metric)
 {
+    struct rtnl_route_info ri;
     int result = 0;
 
+    /* see defaultroute_exists */
+    if (rtnetlink_getroute(AF_INET6, &in6addr_any, 1, &ri) > 0) {
+	if (ri.dst_len == 0 && ri.table == RT_TABLE_MAIN
+	    && ri.type == RTN_UNICAST && ri.oif > 0
+	    && (metric < 0 || ri.priority == metric)) {
+	    memset(rt, 0, sizeof(*rt));
+	    rt->rtmsg_flags = RTF_UP;
+	    if (ri.has_gateway) {
+		memcpy(&rt->rtmsg_gateway, ri.gateway, 16);
+		rt->rtmsg_flags |= RTF_GATEWAY;
+	    }
+	    rt->rtmsg_metric = ri.priority;
+	    rt->rtmsg_ifindex = ri.oif;
+	    return 1;
+	}
+    }
+
     if (!open_route6_table())
 	return 0;
 
@@ -2578,6 +2846,210 @@ int cifproxyarp (int unit, u_int32_t his_adr)
     return 1;
 }
 
+/********************************************************************
+ *
+ * rtnetlink_getlink - get the flags, name and hardware address of the
+ * interface with the given index.  Returns 1 on success, 0 otherwise.
+ */
+
+struct rtnl_link_info {
+    unsigned int	flags;		/* IFF_* flags */
+    unsigned short	type;		/* ARPHRD_* hardware type */
+    int			addrlen;	/* length of hwaddr, 0 if none */
+    unsigned char	hwaddr[sizeof(((struct sockaddr *)0)->sa_data)];
+    char		name[IFNAMSIZ];
+};
+
+static int rtnetlink_getlink(int *fd, int index, struct rtnl_link_info *li)
+{
+    struct {
+        struct nlmsghdr nlh;
+        struct ifinfomsg ifi;
+    } nlreq;
+    struct {
+        struct ifinfomsg ifi;
+        unsigned char attrs[4096];
+    } nlresp_data;
+    size_t nlresp_size;
+    struct rtattr *rta;
+    int rtalen, resp;
+
+    memset(&nlreq, 0, sizeof(nlreq));
+    nlreq.nlh.nlmsg_len = sizeof(nlreq);
+    nlreq.nlh.nlmsg_type = RTM_GETLINK;
+    nlreq.nlh.nlmsg_flags = NLM_F_REQUEST;
+    nlreq.ifi.ifi_family = AF_UNSPEC;
+    nlreq.ifi.ifi_index = index;
+
+    nlresp_size = sizeof(nlresp_data);
+    resp = rtnetlink_msg("RTM_GETLINK/NLM_F_REQUEST", fd, &nlreq, sizeof(nlreq), &nlresp_data, &nlresp_size, RTM_NEWLINK);
+    if (resp > 0) {
+        close(*fd);
+        *fd = -1;
+    }
+    if (resp || nlresp_size < NLMSG_ALIGN(sizeof(struct ifinfomsg)))
+        return 0;
+
+    memset(li, 0, sizeof(*li));
+    li->flags = nlresp_data.ifi.ifi_flags;
+    li->type = nlresp_data.ifi.ifi_type;
+
+    rta = IFLA_RTA(&nlresp_data.ifi);
+    rtalen = nlresp_size - NLMSG_ALIGN(sizeof(struct ifinfomsg));
+    for (; RTA_OK(rta, rtalen); rta = RTA_NEXT(rta, rtalen)) {
+        switch (rta->rta_type) {
+        case IFLA_IFNAME:
+            strlcpy(li->name, RTA_DATA(rta), MIN(sizeof(li->name), RTA_PAYLOAD(rta)));
+            break;
+        case IFLA_ADDRESS:
+            li->addrlen = MIN(sizeof(li->hwaddr), RTA_PAYLOAD(rta));
+            memcpy(li->hwaddr, RTA_DATA(rta), li->addrlen);
+            break;
+        }
+    }
+
+    return li->name[0] != 0;
+}
+
+/********************************************************************
+ *
+ * get_ether_addr_rtnetlink - find the interface for proxy ARP from
+ * one RTM_GETADDR dump, then look up the flags and hardware address
+ * of only the interfaces whose subnet contains ipaddr.  Unlike the
+ * SIOCGIFCONF scan there is no limit on the number of addresses.
+ * Returns 1 if found, 0 if there is no such interface, or -1 if
+ * netlink could not be used.
+ */
+
+static int get_ether_addr_rtnetlink (u_int32_t ipaddr,
+				     struct sockaddr *hwaddr,
+				     char *name, int namelen)
+{
+    struct {
+        struct nlmsghdr nlh;
+        struct ifaddrmsg ifa;
+    } nlreq;
+    struct sockaddr_nl nladdr;
+    struct nlmsghdr *nlh;
+    struct ifaddrmsg *ifa;
+    struct rtattr *rta;
+    struct rtnl_link_info li, bestli;
+    struct {
+        int index;
+        u_int32_t mask;
+    } *cand = NULL, *p;
+    int ncand = 0, maxcand = 0;
+    u_int32_t ina, mask, bestmask = 0;
+    int fd, len, rtalen, i, done, ret = -1;
+    long buf[8192 / sizeof(long)];
+
+    fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0)
+	return -1;
+
+    memset(&nlreq, 0, sizeof(nlreq));
+    nlreq.nlh.nlmsg_len = sizeof(nlreq);
+    nlreq.nlh.nlmsg_type = RTM_GETADDR;
+    nlreq.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    nlreq.ifa.ifa_family = AF_INET;
+
+    memset(&nladdr, 0, sizeof(nladdr));
+    nladdr.nl_family = AF_NETLINK;
+    if (sendto(fd, &nlreq, sizeof(nlreq), 0, (struct sockaddr *)&nladdr,
+	       sizeof(nladdr)) < 0) {
+	error("get_ether_addr: sendto(RTM_GETADDR): %m");
+	goto out;
+    }
+
+    for (done = 0; !done; ) {
+	len = recv(fd, buf, sizeof(buf), 0);
+	if (len < 0) {
+	    if (errno == EINTR)
+		continue;
+	    error("get_ether_addr: recv(RTM_GETADDR): %m");
+	    goto out;
+	}
+	if (len == 0)
+	    goto out;
+	for (nlh = (struct nlmsghdr *) buf; NLMSG_OK(nlh, len);
+	     nlh = NLMSG_NEXT(nlh, len)) {
+	    if (nlh->nlmsg_type == NLMSG_DONE) {
+		done = 1;
+		break;
+	    }
+	    if (nlh->nlmsg_type == NLMSG_ERROR)
+		goto out;
+	    if (nlh->nlmsg_type != RTM_NEWADDR
+		|| nlh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifa)))
+		continue;
+
+	    ifa = NLMSG_DATA(nlh);
+	    if (ifa->ifa_family != AF_INET || ifa->ifa_prefixlen > 32)
+		continue;
+	    ina = 0;
+	    rta = IFA_RTA(ifa);
+	    rtalen = IFA_PAYLOAD(nlh);
+	    for (; RTA_OK(rta, rtalen); rta = RTA_NEXT(rta, rtalen)) {
+		if (RTA_PAYLOAD(rta) < sizeof(u_int32_t))
+		    continue;
+		/* IFA_LOCAL is what SIOCGIFCONF reports, if present */
+		if (rta->rta_type == IFA_LOCAL
+		    || (rta->rta_type == IFA_ADDRESS && ina == 0))
+		    memcpy(&ina, RTA_DATA(rta), sizeof(ina));
+	    }
+	    mask = ifa->ifa_prefixlen?
+		htonl(~0U << (32 - ifa->ifa_prefixlen)): 0;
+	    if (((ipaddr ^ ina) & mask) != 0)
+		continue;
+
+	    if (ncand >= maxcand) {
+		maxcand = maxcand? 2 * maxcand: 8;
+		p = realloc(cand, maxcand * sizeof(*cand));
+		if (p == NULL)
+		    goto out;
+		cand = p;
+	    }
+	    cand[ncand].index = ifa->ifa_index;
+	    cand[ncand].mask = mask;
+	    ++ncand;
+	}
+    }
+    close(fd);
+
+/*
+ * Check that the interface is up, and not point-to-point
+ * nor loopback, and keep the one with the longest netmask.
+ */
+    fd = -1;
+    ret = 0;
+    for (i = 0; i < ncand; ++i) {
+	if (ntohl(cand[i].mask) < ntohl(bestmask))
+	    continue;
+	if (!rtnetlink_getlink(&fd, cand[i].index, &li))
+	    continue;
+	if (((li.flags ^ FLAGS_GOOD) & FLAGS_MASK) != 0)
+	    continue;
+	/* >= as in get_ether_addr, a netmask may be 0.0.0.0 */
+	bestli = li;
+	bestmask = cand[i].mask;
+	ret = 1;
+    }
+
+    if (ret) {
+	strlcpy(name, bestli.name, namelen);
+	info("found interface %s for proxy arp", name);
+	memset(hwaddr, 0, sizeof(*hwaddr));
+	hwaddr->sa_family = bestli.type;
+	memcpy(hwaddr->sa_data, bestli.hwaddr, bestli.addrlen);
+    }
+
+ out:
+    if (fd >= 0)
+	close(fd);
+    free(cand);
+    return ret;
+}
+
 /********************************************************************
  *
  * get_ether_addr - get the hardware address of an interface on the
@@ -2598,6 +3070,11 @@ static int get_ether_addr (u_int32_t ipaddr,
     u_int32_t bestmask=0;
     int found_interface = 0;
 
+    found_interface = get_ether_addr_rtnetlink(ipaddr, hwaddr, name, namelen);
+    if (found_interface >= 0)
+	return found_interface;
+    found_interface = 0;
+
     ifc.ifc_len = sizeof(ifs);
     ifc.ifc_req = ifs;
     if (ioctl(sock_fd, SIOCGIFCONF, &ifc) < 0) {
@@ -3166,6 +3643,43 @@ int sif6down (int u)
 }
 #endif /* PPP_WITH_IPV6CP */
 
+/********************************************************************
+ *
+ * setifstate_rtnetlink - Config the interface up or down with a single
+ * RTM_NEWLINK request, instead of reading and then writing the flags.
+ */
+
+static int setifstate_rtnetlink (int state)
+{
+    struct {
+        struct nlmsghdr nlh;
+        struct ifinfomsg ifi;
+        struct {
+            struct rtattr rta;
+            char ifname[IFNAMSIZ];
+        } ifn;
+    } nlreq;
+    int resp;
+
+    memset(&nlreq, 0, sizeof(nlreq));
+    nlreq.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(nlreq.ifi)) + RTA_SPACE(strlen(ifname) + 1);
+    nlreq.nlh.nlmsg_type = RTM_NEWLINK;
+    nlreq.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+    nlreq.ifi.ifi_family = AF_UNSPEC;
+    nlreq.ifi.ifi_flags = state? IFF_UP: 0;
+    nlreq.ifi.ifi_change = IFF_UP;
+    nlreq.ifn.rta.rta_len = RTA_LENGTH(strlen(ifname) + 1);
+    nlreq.ifn.rta.rta_type = IFLA_IFNAME;
+    strlcpy(nlreq.ifn.ifname, ifname, sizeof(nlreq.ifn.ifname));
+
+    resp = rtnetlink_msg("RTM_NEWLINK/IFF_UP", &rtnl_conf_fd, &nlreq, nlreq.nlh.nlmsg_len, NULL, NULL, 0);
+    if (resp > 0) {
+        close(rtnl_conf_fd);
+        rtnl_conf_fd = -1;
+    }
+    return resp == 0;
+}
+
 /********************************************************************
  *
  * setifstate - Config the interface up or down
@@ -3175,6 +3689,10 @@ static int setifstate (int u, int state)
 {
     struct ifreq ifr;
 
+    /* PPP interfaces are always point-to-point, so only IFF_UP changes */
+    if (kernel_version >= KVERSION(2,6,0) && setifstate_rtnetlink(state))
+	return 1;
+
     memset (&ifr, '\0', sizeof (ifr));
     strlcpy(ifr.ifr_name, ifname, sizeof (ifr.ifr_name));
     if (ioctl(sock_fd, SIOCGIFFLAGS, (caddr_t) &ifr) < 0) {
@@ -3196,6 +3714,100 @@ static int setifstate (int u, int state)
     return 1;
 }
 
+/********************************************************************
+ *
+ * flush_ifaddr_rtnetlink - Remove every IPv4 address from the interface.
+ * An RTM_DELADDR request with only the interface index deletes the
+ * first address, so repeat it until there are none left.
+ * Returns 1 on success, 0 if netlink failed.
+ */
+
+static int flush_ifaddr_rtnetlink (unsigned int iface)
+{
+    struct {
+        struct nlmsghdr nlh;
+        struct ifaddrmsg ifa;
+    } nlreq;
+    int resp, i;
+
+    for (i = 0; i < 256; ++i) {
+        memset(&nlreq, 0, sizeof(nlreq));
+        nlreq.nlh.nlmsg_len = sizeof(nlreq);
+        nlreq.nlh.nlmsg_type = RTM_DELADDR;
+        nlreq.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+        nlreq.ifa.ifa_family = AF_INET;
+        nlreq.ifa.ifa_index = iface;
+
+        resp = rtnetlink_msg("RTM_DELADDR/AF_INET", &rtnl_conf_fd, &nlreq, sizeof(nlreq), NULL, NULL, 0);
+        if (resp == -EADDRNOTAVAIL)
+            return 1;
+        if (resp > 0) {
+            close(rtnl_conf_fd);
+            rtnl_conf_fd = -1;
+        }
+        if (resp)
+            return 0;
+    }
+    return 0;
+}
+
+/********************************************************************
+ *
+ * sifaddr_rtnetlink - Config the interface local and peer IPv4 addresses
+ * with a /32 prefix in one RTM_NEWADDR request, rather than separate
+ * SIOCSIFADDR, SIOCSIFDSTADDR and SIOCSIFNETMASK ioctls.
+ * RTM_NEWADDR only replaces an identical address and adds any other,
+ * whereas SIOCSIFADDR replaces the primary one, so first remove what
+ * is there: a unit from the unit pool may still carry an old address.
+ */
+
+static int sifaddr_rtnetlink (unsigned int iface, u_int32_t our_adr,
+			      u_int32_t his_adr)
+{
+    struct {
+        struct nlmsghdr nlh;
+        struct ifaddrmsg ifa;
+        struct {
+            struct rtattr rta;
+            u_int32_t addr;
+        } addrs[2];
+    } nlreq;
+    int resp;
+
+    if (!flush_ifaddr_rtnetlink(iface))
+        return 0;
+
+    memset(&nlreq, 0, sizeof(nlreq));
+    nlreq.nlh.nlmsg_len = sizeof(nlreq);
+    nlreq.nlh.nlmsg_type = RTM_NEWADDR;
+    nlreq.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | NLM_F_CREATE | NLM_F_REPLACE;
+    nlreq.ifa.ifa_family = AF_INET;
+    nlreq.ifa.ifa_prefixlen = 32;
+    nlreq.ifa.ifa_scope = RT_SCOPE_UNIVERSE;
+    nlreq.ifa.ifa_index = iface;
+    nlreq.addrs[0].rta.rta_len = sizeof(nlreq.addrs[0]);
+    nlreq.addrs[0].rta.rta_type = IFA_LOCAL;
+    nlreq.addrs[0].addr = our_adr;
+    nlreq.addrs[1].rta.rta_len = sizeof(nlreq.addrs[1]);
+    nlreq.addrs[1].rta.rta_type = IFA_ADDRESS;
+    /* see sif6addr_rtnetlink for why IFA_ADDRESS repeats the local address */
+    nlreq.addrs[1].addr = his_adr? his_adr: our_adr;
+
+    resp = rtnetlink_msg("RTM_NEWADDR/AF_INET", &rtnl_conf_fd, &nlreq, sizeof(nlreq), NULL, NULL, 0);
+    if (resp > 0) {
+        close(rtnl_conf_fd);
+        rtnl_conf_fd = -1;
+    }
+    if (resp) {
+        errno = (resp < 0) ? -resp : EINVAL;
+        if (errno != EEXIST && !ok_error(errno))
+            dbglog("sifaddr_rtnetlink: %m, trying ioctl");
+        return 0;
+    }
+
+    return 1;
+}
+
 /********************************************************************
  *
  * sifaddr - Config the interface IP addresses and netmask.
@@ -3206,6 +3818,17 @@ int sifaddr (int unit, u_int32_t our_adr, u_int32_t his_adr,
 {
     struct ifreq   ifr;
     struct rtentry rt;
+    unsigned int   iface;
+
+    /*
+     * sifaddr_rtnetlink clears any old addresses first, so setting the
+     * address over netlink has the same effect as the SIOCSIFADDR
+     * below; the netmask is always /32 on these kernels.
+     */
+    if (kernel_version >= KVERSION(2,6,0)
+	&& (iface = if_nametoindex(ifname)) != 0
+	&& sifaddr_rtnetlink(iface, our_adr, his_adr))
+	goto addr_set;
 
     memset (&ifr, '\0', sizeof (ifr));
     memset (&rt,  '\0', sizeof (rt));
@@ -3278,6 +3901,7 @@ int sifaddr (int unit, u_int32_t our_adr, u_int32_t his_adr,
 	}
     }
 
+ addr_set:
     /* set ip_dynaddr in demand mode if address changes */
     if (demand && tune_kernel && !dynaddr_set
 	&& our_old_addr && our_old_addr != our_adr) {
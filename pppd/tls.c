@@ -31,6 +31,7 @@
 #endif
 
 #include <string.h>
+#include <sys/stat.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <openssl/x509v3.h>
@@ -350,11 +351,73 @@ int tls_set_opts(SSL_CTX *ctx) {
     return 0;
 }
 
+/*
+ * The last CRL file parsed by tls_set_crl().  CRLs can be large, so the
+ * parsed copy is kept and added to later SSL contexts as long as the
+ * file's mtime, inode and size are unchanged.
+ */
+static struct {
+    X509_CRL *crl;
+    char     *path;
+    time_t    mtime;
+    ino_t     ino;
+    off_t     size;
+    unsigned  hits;
+    unsigned  misses;
+} tls_crl_cache;
+
+static X509_CRL *tls_load_crl(const char *crl_file)
+{
+    struct stat st;
+    X509_CRL *crl;
+    FILE *fp;
+
+    if (stat(crl_file, &st) < 0) {
+        error("Cannot open CRL file '%s': %m", crl_file);
+        return NULL;
+    }
+
+    if (tls_crl_cache.crl && strcmp(tls_crl_cache.path, crl_file) == 0
+        && tls_crl_cache.mtime == st.st_mtime
+        && tls_crl_cache.ino == st.st_ino
+        && tls_crl_cache.size == st.st_size) {
+        ++tls_crl_cache.hits;
+        dbglog("Using cached CRL from '%s' (%u hits, %u misses)", crl_file,
+               tls_crl_cache.hits, tls_crl_cache.misses);
+        return tls_crl_cache.crl;
+    }
+    ++tls_crl_cache.misses;
+
+    fp = fopen(crl_file, "r");
+    if (!fp) {
+        error("Cannot open CRL file '%s'", crl_file);
+        return NULL;
+    }
+
+    crl = PEM_read_X509_CRL(fp, NULL, NULL, NULL);
+    fclose(fp);
+    if (!crl) {
+        error("Cannot read CRL file '%s'", crl_file);
+        return NULL;
+    }
+
+    if (tls_crl_cache.crl)
+        X509_CRL_free(tls_crl_cache.crl);
+    free(tls_crl_cache.path);
+    tls_crl_cache.crl = crl;
+    tls_crl_cache.path = strdup(crl_file);
+    if (!tls_crl_cache.path)
+        novm("CRL file name");
+    tls_crl_cache.mtime = st.st_mtime;
+    tls_crl_cache.ino = st.st_ino;
+    tls_crl_cache.size = st.st_size;
+    return crl;
+}
+
 int tls_set_crl(SSL_CTX *ctx, const char *crl_dir, const char *crl_file) 
 {
     X509_STORE  *certstore = NULL;
     X509_LOOKUP *lookup = NULL;
-    FILE *fp = NULL;
     int status = -1;
 
     if (crl_dir) {
@@ -374,17 +437,8 @@ int tls_set_crl(SSL_CTX *ctx, const char *crl_dir, const char *crl_file)
     }
 
     if (crl_file) {
-        X509_CRL *crl = NULL;
-
-        fp = fopen(crl_file, "r");
-        if (!fp) {
-            error("Cannot open CRL file '%s'", crl_file);
-            goto done;
-        }
-
-        crl = PEM_read_X509_CRL(fp, NULL, NULL, NULL);
+        X509_CRL *crl = tls_load_crl(crl_file);
         if (!crl) {
-            error("Cannot read CRL file '%s'", crl_file);
             goto done;
         }
 
@@ -392,6 +446,7 @@ int tls_set_crl(SSL_CTX *ctx, const char *crl_dir, const char *crl_file)
             error("Failed to get certificate store");
             goto done;
         }
+        /* The store takes its own reference to the cached CRL */
         if (!X509_STORE_add_crl(certstore, crl)) {
             error("Cannot add CRL to certificate store");
             goto done;
@@ -403,10 +458,6 @@ int tls_set_crl(SSL_CTX *ctx, const char *crl_dir, const char *crl_file)
 
 done: 
 
-    if (fp != NULL) {
-        fclose(fp);
-    }
-
     return status;
 }
 
@@ -0,0 +1,462 @@
+/*
+ * trace.c - In-memory ring of recently sent and received packets,
+ * and a control socket for adjusting and dumping it at run time.
+ *
+ * Copyright (c) 2026 The ppp project contributors. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The name(s) of the authors of this software must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission.
+ *
+ * THE AUTHORS OF THIS SOFTWARE DISCLAIM ALL WARRANTIES WITH REGARD TO
+ * THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/*
+ * Formatting a control packet with %P is by far the most expensive
+ * part of running with `debug'.  The trace ring instead stores the raw
+ * bytes of each packet along with a timestamp, which costs little more
+ * than a memcpy, and only decodes them when somebody asks for a dump.
+ * That makes it cheap enough to leave enabled on busy systems and
+ * still have the last few hundred packets available after a failure.
+ *
+ * What goes into the ring can be narrowed down to particular protocols,
+ * to sessions with a particular authenticated peer name, or to a random
+ * 1-in-n sample of sessions, so that on a busy concentrator running
+ * many pppd processes only the interesting ones pay for tracing.
+ *
+ * If a control socket is configured, each connection to it carries a
+ * single command line and gets a text reply:
+ *	dump			decode the ring
+ *	clear			empty the ring
+ *	buffer <n>		keep the last n packets (0 turns tracing off)
+ *	protocols <list>|all	only record these protocols
+ *	peer <name>|any		only record sessions with this peer
+ *	sample <n>		only record 1 in n sessions
+ *	status			show the current settings
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "pppd-private.h"
+#include "options.h"
+#include "magic.h"
+
+#define TRACE_SNAPLEN	128	/* max bytes kept from each packet */
+#define TRACE_MAXPROTO	16	/* max # protocols in a filter */
+
+struct trace_rec {
+    struct timeval	tv;		/* when it was sent/received */
+    const char		*tag;		/* "sent" or "rcvd" */
+    int			len;		/* original length of packet */
+    int			caplen;		/* number of bytes in data[] */
+    unsigned char	data[TRACE_SNAPLEN];
+};
+
+static int trace_buffer = 0;	/* # packets to keep, 0 = disabled */
+static int trace_sample = 1;	/* trace 1 in this many sessions */
+static char trace_peer[MAXNAMELEN];	/* only trace this peer, if set */
+static char trace_sockpath[MAXPATHLEN];	/* control socket pathname */
+
+static u_short trace_protos[TRACE_MAXPROTO];	/* protocols to record */
+static int trace_nprotos;		/* # entries in trace_protos, 0 = all */
+
+static struct trace_rec *trace_ring;	/* the ring itself */
+static int trace_size;			/* # entries in trace_ring */
+static unsigned int trace_head;		/* total # packets recorded */
+static bool trace_sampled = 1;		/* this session was picked */
+static int trace_ctl_fd = -1;		/* listening control socket */
+
+static int setprotocols(char **);
+static int set_trace_protocols(const char *);
+static void trace_phase_change(void *, int);
+
+static struct option trace_options[] = {
+    { "trace-buffer", o_int, &trace_buffer,
+      "Keep the last n packets in memory for later dumping",
+      OPT_PRIO | OPT_LIMITS, NULL, 65536, 0 },
+    { "trace-protocols", o_special, (void *)setprotocols,
+      "Only record these protocols in the trace buffer", OPT_PRIO },
+    { "trace-peer", o_string, trace_peer,
+      "Only record sessions with this peer in the trace buffer",
+      OPT_PRIO | OPT_STATIC, NULL, MAXNAMELEN },
+    { "trace-sample", o_int, &trace_sample,
+      "Only record 1 in n sessions in the trace buffer",
+      OPT_PRIO | OPT_LLIMIT, NULL, 0, 1 },
+    { "trace-socket", o_string, trace_sockpath,
+      "Unix socket for controlling the trace buffer",
+      OPT_PRIO | OPT_PRIV | OPT_STATIC, NULL, MAXPATHLEN },
+
+    { NULL }
+};
+
+/*
+ * trace_init - register our options.
+ */
+void
+trace_init(void)
+{
+    ppp_add_options(trace_options);
+}
+
+/*
+ * setprotocols - parse the trace-protocols option.
+ */
+static int
+setprotocols(char **argv)
+{
+    if (!set_trace_protocols(*argv)) {
+	ppp_option_error("unknown protocol in trace-protocols list '%s'",
+			 *argv);
+	return 0;
+    }
+    return 1;
+}
+
+/*
+ * set_trace_protocols - set the protocol filter from a list of
+ * protocol names separated by commas, or "all".
+ * Returns 0 if a name wasn't recognized.
+ */
+static int
+set_trace_protocols(const char *list)
+{
+    u_short protos[TRACE_MAXPROTO];
+    char buf[256], *name, *next;
+    struct protent *protp;
+    int i, n;
+
+    n = 0;
+    if (strcasecmp(list, "all") != 0) {
+	strlcpy(buf, list, sizeof(buf));
+	for (name = buf; name != NULL && *name != 0; name = next) {
+	    next = strchr(name, ',');
+	    if (next != NULL)
+		*next++ = 0;
+	    for (i = 0; (protp = protocols[i]) != NULL; ++i)
+		if (strcasecmp(name, protp->name) == 0)
+		    break;
+	    if (protp == NULL)
+		return 0;
+	    if (n < TRACE_MAXPROTO)
+		protos[n++] = protp->protocol;
+	}
+    }
+    memcpy(trace_protos, protos, n * sizeof(u_short));
+    trace_nprotos = n;
+    return 1;
+}
+
+/*
+ * trace_wanted - decide whether a packet should go in the ring.
+ */
+static int
+trace_wanted(unsigned char *p, int len)
+{
+    int i, proto;
+
+    if (!trace_sampled)
+	return 0;
+    if (trace_peer[0] != 0 && peer_authname[0] != 0
+	&& strcmp(trace_peer, peer_authname) != 0) {
+	/* not the peer we're after; forget what we saw before auth */
+	trace_sampled = 0;
+	trace_head = 0;
+	return 0;
+    }
+    if (trace_nprotos == 0)
+	return 1;
+    proto = (p[2] << 8) + p[3];
+    for (i = 0; i < trace_nprotos; ++i)
+	if (proto == trace_protos[i])
+	    return 1;
+    return 0;
+}
+
+/*
+ * trace_phase_change - pick whether to trace each new session.
+ */
+static void
+trace_phase_change(void *arg, int phase)
+{
+    if (phase == PHASE_ESTABLISH)
+	trace_sampled = trace_sample <= 1 || magic() % trace_sample == 0;
+}
+
+/*
+ * trace_packet - record a packet in the trace ring.
+ * Assumes len >= PPP_HDRLEN.
+ */
+void
+trace_packet(const char *tag, unsigned char *p, int len)
+{
+    struct trace_rec *rec;
+
+    if (trace_buffer <= 0 || !trace_wanted(p, len))
+	return;
+    if (trace_ring == NULL || trace_size != trace_buffer) {
+	free(trace_ring);
+	trace_ring = calloc(trace_buffer, sizeof(struct trace_rec));
+	trace_head = 0;
+	if (trace_ring == NULL) {
+	    error("Couldn't allocate packet trace buffer");
+	    trace_buffer = 0;
+	    trace_size = 0;
+	    return;
+	}
+	trace_size = trace_buffer;
+    }
+
+    rec = &trace_ring[trace_head++ % trace_size];
+    gettimeofday(&rec->tv, NULL);
+    rec->tag = tag;
+    rec->len = len;
+    rec->caplen = len < TRACE_SNAPLEN? len: TRACE_SNAPLEN;
+    memcpy(rec->data, p, rec->caplen);
+}
+
+/*
+ * trace_dump - decode the packets in the trace ring, oldest first,
+ * calling `printer(arg, format, ...)' to output them.
+ */
+void
+trace_dump(printer_func printer, void *arg)
+{
+    unsigned int i, n;
+    struct trace_rec *rec;
+
+    if (trace_ring == NULL)
+	return;
+    n = trace_head < trace_size? trace_head: trace_size;
+    for (i = trace_head - n; i != trace_head; ++i) {
+	rec = &trace_ring[i % trace_size];
+	printer(arg, "%ld.%06ld %s %P%s\n", (long) rec->tv.tv_sec,
+		(long) rec->tv.tv_usec, rec->tag, rec->data, rec->caplen,
+		rec->caplen < rec->len? " (truncated)": "");
+    }
+}
+
+/*
+ * trace_log_printer - printer for trace_dump that logs each line.
+ */
+static void
+trace_log_printer(void *arg, char *fmt, ...)
+{
+    va_list pvar;
+    char buf[1024];
+    int n;
+
+    va_start(pvar, fmt);
+    n = vslprintf(buf, sizeof(buf), fmt, pvar);
+    va_end(pvar);
+
+    if (n > 0 && buf[n-1] == '\n')
+	buf[n-1] = 0;
+    notice("%s", buf);
+}
+
+/*
+ * trace_log - write the contents of the trace ring to the log.
+ */
+void
+trace_log(void)
+{
+    unsigned int n;
+
+    if (trace_ring == NULL || trace_head == 0)
+	return;
+    n = trace_head < trace_size? trace_head: trace_size;
+    notice("Last %u of %u traced packets:", n, trace_head);
+    trace_dump(trace_log_printer, NULL);
+}
+
+/*
+ * trace_reply - printer for trace_dump that writes to a control
+ * socket connection.
+ */
+static void
+trace_reply(void *arg, char *fmt, ...)
+{
+    va_list pvar;
+    char buf[1024];
+    int n, fd = *(int *)arg;
+
+    va_start(pvar, fmt);
+    n = vslprintf(buf, sizeof(buf), fmt, pvar);
+    va_end(pvar);
+
+    if (fd >= 0 && write(fd, buf, n) != n)
+	*(int *)arg = -1;	/* client went away; stop writing */
+}
+
+/*
+ * trace_command - carry out one control socket command.
+ */
+static void
+trace_command(char *cmd, int fd)
+{
+    char *arg;
+    int n;
+
+    arg = strchr(cmd, ' ');
+    if (arg != NULL) {
+	*arg++ = 0;
+	arg += strspn(arg, " ");
+    } else
+	arg = "";
+
+    if (strcmp(cmd, "dump") == 0) {
+	trace_dump(trace_reply, &fd);
+    } else if (strcmp(cmd, "clear") == 0) {
+	trace_head = 0;
+	trace_reply(&fd, "ok\n");
+    } else if (strcmp(cmd, "buffer") == 0 && *arg != 0) {
+	n = atoi(arg);
+	trace_buffer = n < 0? 0: n > 65536? 65536: n;
+	if (trace_buffer == 0) {
+	    free(trace_ring);
+	    trace_ring = NULL;
+	    trace_size = 0;
+	}
+	trace_reply(&fd, "ok\n");
+    } else if (strcmp(cmd, "protocols") == 0 && *arg != 0) {
+	if (set_trace_protocols(arg))
+	    trace_reply(&fd, "ok\n");
+	else
+	    trace_reply(&fd, "error: unknown protocol\n");
+    } else if (strcmp(cmd, "peer") == 0 && *arg != 0) {
+	if (strcmp(arg, "any") == 0)
+	    trace_peer[0] = 0;
+	else
+	    strlcpy(trace_peer, arg, sizeof(trace_peer));
+	trace_sampled = 1;
+	trace_reply(&fd, "ok\n");
+    } else if (strcmp(cmd, "sample") == 0 && *arg != 0) {
+	n = atoi(arg);
+	trace_sample = n < 1? 1: n;
+	trace_reply(&fd, "ok\n");
+    } else if (strcmp(cmd, "status") == 0) {
+	trace_reply(&fd, "buffer %d\nrecorded %u\nsample %d\nsampled %d\n"
+		    "peer %s\nprotocols %d\n", trace_buffer, trace_head,
+		    trace_sample, trace_sampled,
+		    trace_peer[0]? trace_peer: "any", trace_nprotos);
+    } else
+	trace_reply(&fd, "error: unknown command\n");
+}
+
+/*
+ * trace_start - create the control socket, if one was requested,
+ * and start watching for new sessions.
+ */
+void
+trace_start(void)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    ppp_add_notify(NF_PHASE_CHANGE, trace_phase_change, NULL);
+
+    if (trace_sockpath[0] == 0)
+	return;
+    if (strlen(trace_sockpath) >= sizeof(addr.sun_path)) {
+	error("Trace socket path %s is too long", trace_sockpath);
+	return;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+	error("Couldn't create trace socket: %m");
+	return;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strlcpy(addr.sun_path, trace_sockpath, sizeof(addr.sun_path));
+    unlink(trace_sockpath);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+	|| chmod(trace_sockpath, S_IRUSR | S_IWUSR) < 0
+	|| listen(fd, 4) < 0) {
+	error("Couldn't set up trace socket %s: %m", trace_sockpath);
+	close(fd);
+	return;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    trace_ctl_fd = fd;
+    add_fd(fd);
+}
+
+/*
+ * trace_check - serve any pending connections on the control socket.
+ */
+void
+trace_check(void)
+{
+    struct timeval tv;
+    char buf[256];
+    int fd, n;
+
+    if (trace_ctl_fd < 0)
+	return;
+    while ((fd = accept(trace_ctl_fd, NULL, NULL)) >= 0) {
+	/* don't let a slow client hold up the rest of pppd for long */
+	tv.tv_sec = 1;
+	tv.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	n = read(fd, buf, sizeof(buf) - 1);
+	if (n > 0) {
+	    buf[n] = 0;
+	    buf[strcspn(buf, "\r\n")] = 0;
+	    trace_command(buf, fd);
+	}
+	close(fd);
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+	error("Error accepting trace socket connection: %m");
+}
+
+/*
+ * trace_cleanup - remove the control socket.
+ */
+void
+trace_cleanup(void)
+{
+    if (trace_ctl_fd < 0)
+	return;
+    remove_fd(trace_ctl_fd);
+    close(trace_ctl_fd);
+    trace_ctl_fd = -1;
+    unlink(trace_sockpath);
+}
@@ -629,10 +629,32 @@ logit(int level, const char *fmt, va_list args)
 {
     char buf[1024];
 
+    if (!log_level_enabled(level))
+	return;
     vslprintf(buf, sizeof(buf), fmt, args);
     log_write(level, buf);
 }
 
+/*
+ * log_level_enabled - tell whether a message at this level would be
+ * written anywhere, so that callers can avoid formatting it.
+ */
+#ifndef UNIT_TEST
+bool
+log_level_enabled(int level)
+{
+    if (log_to_fd >= 0 && (level != LOG_DEBUG || debug))
+	return 1;
+    return (setlogmask(0) & LOG_MASK(level)) != 0;
+}
+#else
+bool
+log_level_enabled(int level)
+{
+    return 1;
+}
+#endif
+
 #ifndef UNIT_TEST
 static void
 log_write(int level, char *buf)
@@ -756,7 +778,10 @@ dump_packet(const char *tag, unsigned char *p, int len)
 {
     int proto;
 
-    if (!debug)
+#ifndef UNIT_TEST
+    trace_packet(tag, p, len);
+#endif
+    if (!debug || !log_level_enabled(LOG_DEBUG))
 	return;
 
     /*